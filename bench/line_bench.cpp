@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdio>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "line_solver.h"
+
+/* *
+ * Line solver microbenchmark: bit-parallel kernels picked by `solveLine()`
+ * against the straightforward `solveLineGeneric()` on the same random lines.
+ * Results of both kernels are compared, so the benchmark also checks the kernels agree.
+ * */
+
+namespace {
+    // random black & white line with its clue and partially known cells
+    struct LineCase {
+        Clue clue;
+        std::vector<Cell> cells;
+    };
+
+    LineCase generateLine(int length, std::mt19937& rng) {
+        std::bernoulli_distribution is_filled(0.6);
+        std::bernoulli_distribution is_known(0.3);
+        std::vector<bool> solution(length);
+        for (int i = 0; i < length; i++) {
+            solution[i] = is_filled(rng);
+        }
+        LineCase line_case;
+        for (int i = 0; i < length; i++) {
+            if (!solution[i])
+                continue;
+            if (i > 0 && solution[i - 1]) {
+                line_case.clue.back().length++;
+            } else {
+                line_case.clue.push_back({1, 1});
+            }
+        }
+        // reveal some cells, the rest can be anything
+        line_case.cells.resize(length);
+        for (int i = 0; i < length; i++) {
+            line_case.cells[i] = (is_known(rng) ? (solution[i] ? 0b10 : 0b01) : 0b11);
+        }
+        return line_case;
+    }
+
+    // solve every line with the kernel, returns nanoseconds per line
+    template <typename Kernel>
+    double measure(const std::vector<LineCase>& cases, int repeat_count, Kernel kernel, std::vector<std::vector<Cell>>& results) {
+        results.assign(cases.size(), {});
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeat_count; r++) {
+            for (size_t i = 0; i < cases.size(); i++) {
+                results[i] = cases[i].cells;
+                kernel(cases[i].clue, results[i]);
+            }
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / (repeat_count * cases.size());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("line_bench", "Benchmark line solving kernels");
+    options.add_options()
+        ("help", "Print help")
+        ("n,count", "Number of random lines of every length", cxxopts::value<int>()->default_value("1000"))
+        ("r,repeat", "Number of times every line is solved", cxxopts::value<int>()->default_value("20"))
+        ("seed", "Seed of the lines", cxxopts::value<std::uint32_t>()->default_value("1"))
+    ;
+    auto args = options.parse(argc, argv);
+    if (args.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    const int count = args["count"].as<int>();
+    const int repeat_count = args["repeat"].as<int>();
+    std::mt19937 rng(args["seed"].as<std::uint32_t>());
+
+    std::printf("%8s %14s %14s %9s %11s\n", "length", "generic ns", "solveLine ns", "speedup", "mismatches");
+    for (int length : {10, 25, 50, 63, 100, 127, 200, 255, 400}) {
+        std::vector<LineCase> cases;
+        for (int i = 0; i < count; i++) {
+            cases.push_back(generateLine(length, rng));
+        }
+        std::vector<std::vector<Cell>> generic_results;
+        std::vector<std::vector<Cell>> results;
+        const double generic_ns = measure(cases, repeat_count, solveLineGeneric, generic_results);
+        const double ns = measure(cases, repeat_count, solveLine, results);
+        int mismatch_count = 0;
+        for (int i = 0; i < count; i++) {
+            mismatch_count += (results[i] != generic_results[i]);
+        }
+        std::printf("%8d %14.1f %14.1f %8.1fx %11d\n", length, generic_ns, ns, generic_ns / ns, mismatch_count);
+    }
+    return 0;
+}
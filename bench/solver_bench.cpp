@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "generator.h"
+#include "line_cache.h"
+#include "solver.h"
+
+/* *
+ * Solver benchmark on a fixed corpus of generated puzzles.
+ * The corpus is fully determined by the seed, so the results of different solver versions are comparable.
+ * */
+
+namespace {
+    // group of puzzles of the corpus generated with the same options
+    struct CorpusGroup {
+        std::string name;
+        GeneratorOptions options;
+    };
+
+    std::vector<CorpusGroup> makeCorpus() {
+        using Kind = GeneratorOptions::Kind;
+        std::vector<CorpusGroup> corpus;
+        for (int size : {10, 20, 30, 50}) {
+            for (int color_count : {1, 3}) {
+                const std::string colors = (color_count == 1 ? "bw" : std::to_string(color_count) + "c");
+                const std::string sizes = std::to_string(size) + "x" + std::to_string(size);
+                corpus.push_back({"random " + sizes + " " + colors, {Kind::kRandom, size, size, 0.6, color_count}});
+                corpus.push_back({"structured " + sizes + " " + colors, {Kind::kStructured, size, size, 0.5, color_count}});
+            }
+        }
+        return corpus;
+    }
+
+    // value at percentile `p` of sorted values
+    double percentile(const std::vector<double>& sorted, double p) {
+        const size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+        return sorted[i];
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("solver_bench", "Benchmark nonogram solver on generated puzzles");
+    options.add_options()
+        ("help", "Print help")
+        ("n,count", "Number of puzzles in every group of the corpus", cxxopts::value<int>()->default_value("20"))
+        ("seed", "Seed of the corpus", cxxopts::value<std::uint32_t>()->default_value("1"))
+        ("u,unique", "Also check uniqueness of every puzzle", cxxopts::value<bool>())
+        ("cache", "Share a cache of that many line solving results between all the puzzles of a group (0 to disable)", cxxopts::value<size_t>()->default_value("0"))
+        ("dump", "Save every puzzle of the corpus to the directory in .non format", cxxopts::value<std::string>())
+    ;
+    auto args = options.parse(argc, argv);
+    if (args.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    const int count = args["count"].as<int>();
+    if (count < 1) {
+        std::cerr << "error: count must be at least 1" << std::endl;
+        return 1;
+    }
+    const std::uint32_t seed = args["seed"].as<std::uint32_t>();
+    const bool is_checking_uniqueness = args["unique"].as<bool>();
+    const size_t cache_capacity = args["cache"].as<size_t>();
+    const std::string dump_dir = (args.count("dump") ? args["dump"].as<std::string>() : "");
+    if (!dump_dir.empty()) {
+        std::filesystem::create_directories(dump_dir);
+    }
+
+    std::printf("%-24s %9s %9s %9s %9s %12s %10s %8s %8s %8s\n",
+                "group", "p50 ms", "p90 ms", "p99 ms", "max ms", "lines/s", "nodes", "failed", "unique", "hit %");
+    for (const CorpusGroup& group : makeCorpus()) {
+        std::vector<double> times;
+        Solver::Stats total;
+        int failed_count = 0;
+        int unique_count = 0;
+        std::unique_ptr<LineCache> cache;
+        if (cache_capacity > 0) {
+            cache = std::make_unique<LineCache>(cache_capacity);
+        }
+        for (int i = 0; i < count; i++) {
+            GeneratorOptions puzzle_options = group.options;
+            puzzle_options.seed = seed * 1000003u + i;
+            GeneratedNonogram puzzle = generateNonogram(puzzle_options);
+            if (!dump_dir.empty()) {
+                std::string file_name = group.name + " " + std::to_string(i) + ".non";
+                std::replace(file_name.begin(), file_name.end(), ' ', '_');
+                puzzle.nonogram.saveToFile((std::filesystem::path(dump_dir) / file_name).string());
+            }
+
+            Solver solver(puzzle.nonogram);
+            solver.setLineCache(cache.get());
+            auto start = std::chrono::steady_clock::now();
+            const bool is_solved = solver.solve();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            times.push_back(elapsed.count());
+            total.line_count += solver.stats().line_count;
+            total.node_count += solver.stats().node_count;
+            failed_count += !is_solved;
+            if (is_checking_uniqueness) {
+                unique_count += isUnique(puzzle.nonogram);
+            }
+        }
+
+        std::sort(times.begin(), times.end());
+        double total_ms = 0;
+        for (double time : times) {
+            total_ms += time;
+        }
+        const double lines_per_second = (total_ms > 0 ? total.line_count / (total_ms / 1000) : 0);
+        const std::string unique = (is_checking_uniqueness ? std::to_string(unique_count) : "-");
+        const std::string hit_rate = (cache ? std::to_string((int)std::round(cache->stats().hitRate() * 100)) : "-");
+        std::printf("%-24s %9.3f %9.3f %9.3f %9.3f %12.0f %10lld %8d %8s %8s\n",
+                    group.name.c_str(), percentile(times, 0.5), percentile(times, 0.9), percentile(times, 0.99), times.back(),
+                    lines_per_second, total.node_count, failed_count, unique.c_str(), hit_rate.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cxxopts.hpp>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "image.h"
+
+/* *
+ * Image processing benchmark: the screenshot of a nonogram is processed the same way as before painting
+ * for a number of frames. Reports the time per frame and how many times the image buffers allocated memory,
+ * which is expected to happen only on the first frame.
+ * */
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("vision_bench", "Benchmark nonogram recognition on a screenshot");
+    options.add_options()
+        ("help", "Print help")
+        ("screenshot", "PNG screenshot of a nonogram in clear state and default position", cxxopts::value<std::string>())
+        ("width", "Nonogram width", cxxopts::value<int>())
+        ("height", "Nonogram height", cxxopts::value<int>())
+        ("c,colored", "Nonogram is colored", cxxopts::value<bool>()->default_value("false"))
+        ("n,frames", "Number of frames", cxxopts::value<int>()->default_value("50"))
+    ;
+    options.parse_positional({"screenshot", "width", "height"});
+    options.positional_help("<screenshot> <width> <height>");
+    auto args = options.parse(argc, argv);
+    if (args.count("help") || !args.count("screenshot") || !args.count("width") || !args.count("height")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    const int width = args["width"].as<int>();
+    const int height = args["height"].as<int>();
+    const bool is_colored = args["colored"].as<bool>();
+    const int frame_count = args["frames"].as<int>();
+
+    std::ifstream file(args["screenshot"].as<std::string>(), std::ios::binary);
+    if (!file) {
+        std::cerr << "error: unable to open " << args["screenshot"].as<std::string>() << std::endl;
+        return 1;
+    }
+    const std::vector<uint8_t> png{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    ImageBuffers buffers;
+    double first_ms = 0;
+    int first_allocation_count = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; i++) {
+        auto frame_start = std::chrono::steady_clock::now();
+        Image screen = Image::fromScreenshot(png, &buffers);
+        Image nonogram = screen.extractNonogram();
+        cv::Vec3b bg_color;
+        nonogram.extractGrid(bg_color, width, height);
+        if (is_colored) {
+            std::vector<cv::Vec3b> palette_colors;
+            std::vector<cv::Point> color_coords;
+            screen.extractPalette(palette_colors, color_coords, nonogram.rect_);
+        }
+        if (i == 0) {
+            first_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+            first_allocation_count = buffers.allocationCount();
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    const double rest_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::format("first frame: {:.2f} ms, {} allocations", first_ms, first_allocation_count) << std::endl;
+    if (frame_count > 1) {
+        const int rest_count = frame_count - 1;
+        std::cout << std::format("next {} frames: {:.2f} ms/frame, {:.2f} allocations/frame", rest_count, rest_ms / rest_count,
+                                 (double)(buffers.allocationCount() - first_allocation_count) / rest_count) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "solver.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    bool isNonogramFile(const fs::path& path) {
+        return path.extension() == ".non" || path.extension() == ".cwd";
+    }
+
+    // expand directories into nonogram files
+    std::vector<fs::path> collectFiles(const std::vector<std::string>& paths) {
+        std::vector<fs::path> files;
+        for (const std::string& path : paths) {
+            if (!fs::is_directory(path)) {
+                files.push_back(path);
+                continue;
+            }
+            for (const fs::directory_entry& entry : fs::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file() && isNonogramFile(entry.path())) {
+                    files.push_back(entry.path());
+                }
+            }
+        }
+        return files;
+    }
+
+    char cellChar(int color) {
+        constexpr char kColorChars[] = ".123456789abcdefghijklmnopqrstuvwxyz";
+        return kColorChars[color];
+    }
+
+    // solve a single file and format its result line
+    std::string solveFile(const fs::path& path, LineCache* cache, bool& is_solved) {
+        std::ostringstream line;
+        line << path.string() << '\t';
+        auto start = std::chrono::steady_clock::now();
+        auto elapsedMs = [&] {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count();
+        };
+        is_solved = false;
+        try {
+            Nonogram nonogram = Nonogram::fromFile(path.string());
+            Solver solver(nonogram);
+            solver.setLineCache(cache);
+            if (!solver.solve()) {
+                line << "fail\t" << elapsedMs() << "\tno solution\n";
+                return line.str();
+            }
+            const double ms = elapsedMs();
+            std::vector<int> solution = solver.solution();
+            line << "ok\t" << ms << '\t' << nonogram.width << 'x' << nonogram.height << '\t';
+            for (int row = 0; row < nonogram.height; row++) {
+                if (row > 0) {
+                    line << '/';
+                }
+                for (int col = 0; col < nonogram.width; col++) {
+                    line << cellChar(solution[row * nonogram.width + col]);
+                }
+            }
+            line << '\n';
+            is_solved = true;
+        } catch (std::exception& e) {
+            line << "fail\t" << elapsedMs() << '\t' << e.what() << '\n';
+        }
+        return line.str();
+    }
+}
+
+BatchSummary solveBatch(const std::vector<std::string>& paths, unsigned thread_count, size_t cache_capacity, std::ostream& out) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<fs::path> files = collectFiles(paths);
+    // larger files go first, so that the workers don't end up waiting for one big puzzle at the end
+    auto fileSize = [](const fs::path& path) {
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        return (ec ? 0 : size);
+    };
+    std::vector<std::pair<std::uintmax_t, fs::path>> sized_files;
+    for (fs::path& file : files) {
+        sized_files.emplace_back(fileSize(file), std::move(file));
+    }
+    std::ranges::sort(sized_files, std::greater{}, [](const auto& sized_file) { return sized_file.first; });
+
+    BatchSummary summary;
+    std::mutex out_mutex;
+    std::unique_ptr<LineCache> cache;
+    if (cache_capacity > 0) {
+        cache = std::make_unique<LineCache>(cache_capacity);
+    }
+    {
+        ThreadPool pool(thread_count);
+        for (const auto& [size, file] : sized_files) {
+            pool.submit([&, &file = file] {
+                bool is_solved = false;
+                std::string line = solveFile(file, cache.get(), is_solved);
+                std::lock_guard lock(out_mutex);
+                out << line << std::flush;
+                (is_solved ? summary.solved_count : summary.failed_count)++;
+            });
+        }
+        pool.wait();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    summary.seconds = elapsed.count();
+    if (cache) {
+        summary.cache_hit_rate = cache->stats().hitRate();
+    }
+    return summary;
+}
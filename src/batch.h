@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// totals of a batch run
+struct BatchSummary {
+    int solved_count = 0;
+    int failed_count = 0;
+    double seconds = 0;
+    // share of line solving results taken from the shared cache
+    double cache_hit_rate = 0;
+};
+
+// solve nonogram files on the thread pool, directories are searched recursively for .non and .cwd files
+// results are written to `out` as soon as they are ready, one line per puzzle in the compact answer format:
+//   <path>\tok\t<milliseconds>\t<width>x<height>\t<rows>
+//   <path>\tfail\t<milliseconds>\t<reason>
+// where <rows> are the rows of the solution separated by `/` with a single character per cell:
+// `.` for the background and `1`..`9`, `a`..`z` for the colors
+// 0 threads means one per hardware thread
+// all the puzzles share a cache of `cache_capacity` line solving results (0 disables it)
+BatchSummary solveBatch(const std::vector<std::string>& paths, unsigned thread_count, size_t cache_capacity, std::ostream& out);
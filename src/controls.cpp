@@ -1,71 +1,126 @@
 #include "controls.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdio>
 #include <cstdlib>
-#include <fstream>
 #include <format>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
 #include "asio.hpp"
 #include "subprocess.h"
 
-#define STR_IMPL_(x) #x
-#define STR(x) STR_IMPL_(x)
-
 using asio::ip::tcp;
 
+// adb helper functions
+namespace {
+    // adb command prefix addressing the device
+    std::string adbCommand(const Device& device) {
+        return (device.serial.empty() ? "adb" : std::format("adb -s {}", device.serial));
+    }
+
+    // run adb with the arguments and return its standard output
+    std::vector<uint8_t> readAdbOutput(const Device& device, std::vector<std::string> args) {
+        std::vector<std::string> cmd_strings = {"adb"};
+        if (!device.serial.empty()) {
+            cmd_strings.insert(cmd_strings.end(), {"-s", device.serial});
+        }
+        cmd_strings.insert(cmd_strings.end(), args.begin(), args.end());
+        std::vector<const char*> cmd;
+        for (const std::string& arg : cmd_strings) {
+            cmd.push_back(arg.c_str());
+        }
+        cmd.push_back(NULL);
+
+        subprocess_s process;
+        int result = subprocess_create(
+            cmd.data(),
+            subprocess_option_inherit_environment | subprocess_option_search_user_path,
+            &process
+        );
+        if (result != 0)
+            return {};
+        // read everything before joining, otherwise the process may block on the full pipe
+        std::vector<uint8_t> output;
+        FILE* out = subprocess_stdout(&process);
+        uint8_t buffer[1 << 16];
+        size_t size = 0;
+        while ((size = std::fread(buffer, 1, sizeof(buffer), out)) > 0) {
+            output.insert(output.end(), buffer, buffer + size);
+        }
+        int ret = -1;
+        subprocess_join(&process, &ret);
+        subprocess_destroy(&process);
+        return output;
+    }
+}   // namespace
+
 namespace adb {
-    bool checkDevice() {
-        std::system("adb devices > devices.txt");
-        // read devices.txt and check if any devices are there
-        std::ifstream file("devices.txt");
-        if (!file.is_open())
-            return false;
+    std::vector<std::string> listDevices() {
+        std::vector<uint8_t> output = readAdbOutput({}, {"devices"});
+        std::istringstream stream(std::string(output.begin(), output.end()));
+        std::vector<std::string> serials;
         std::string line;
-        for (int i = 0; i < 2; i++) {
-            // read two lines (we only need the second one)
-            if (!std::getline(file, line)) {
-                return false;
+        // skip the header `List of devices attached`
+        std::getline(stream, line);
+        while (std::getline(stream, line)) {
+            // lines are in the format `<serial>\t<state>`, only ready devices are taken
+            std::istringstream line_stream(line);
+            std::string serial, state;
+            if (line_stream >> serial >> state && state == "device") {
+                serials.push_back(serial);
             }
         }
-        return !line.empty();
+        return serials;
     }
 
-    void takeScreenshot() {
-        std::system("adb exec-out screencap -p > screenshot.png");
+    bool checkDevice() {
+        return !listDevices().empty();
     }
 
-    void tap(unsigned x, unsigned y) {
-        std::string cmd = std::format("adb shell input tap {} {}", x, y);
+    std::vector<uint8_t> takeScreenshot(const Device& device) {
+        return readAdbOutput(device, {"exec-out", "screencap", "-p"});
+    }
+
+    void tap(const Device& device, unsigned x, unsigned y) {
+        std::string cmd = std::format("{} shell input tap {} {}", adbCommand(device), x, y);
         std::system(cmd.c_str());
     }
 
-    void swipe(unsigned x1, unsigned y1, unsigned x2, unsigned y2, std::chrono::milliseconds duration) {
-        std::string cmd = std::format("adb shell input swipe {} {} {} {} {}", x1, y1, x2, y2, duration.count());
+    void swipe(const Device& device, unsigned x1, unsigned y1, unsigned x2, unsigned y2, std::chrono::milliseconds duration) {
+        std::string cmd = std::format("{} shell input swipe {} {} {} {} {}", adbCommand(device), x1, y1, x2, y2, duration.count());
         std::system(cmd.c_str());
     }
 }   // namespace adb
 
 // helper functions
 namespace {
-    void pushServer() {
+    void pushServer(const Device& device) {
         int result = -1;
-        result = std::system("adb push ../third_party/scrcpy-server-v3.3.4 /data/local/tmp/scrcpy-server-manual.jar");
+        std::string cmd = std::format("{} push ../third_party/scrcpy-server-v3.3.4 /data/local/tmp/scrcpy-server-manual.jar", adbCommand(device));
+        result = std::system(cmd.c_str());
         assert(result == 0 && "adb push");
-        result = std::system("adb forward tcp:" STR(SCRCPY_CLIENT_PORT) " localabstract:scrcpy");
+        cmd = std::format("{} forward tcp:{} localabstract:scrcpy", adbCommand(device), device.port);
+        result = std::system(cmd.c_str());
         assert(result == 0 && "adb forward");
     }
 
-    int runServer(subprocess_s* process) {
-        const char* cmd[] = {
-            "adb", "shell", "CLASSPATH=/data/local/tmp/scrcpy-server-manual.jar",
+    int runServer(const Device& device, subprocess_s* process) {
+        std::vector<const char*> cmd = {"adb"};
+        if (!device.serial.empty()) {
+            cmd.insert(cmd.end(), {"-s", device.serial.c_str()});
+        }
+        cmd.insert(cmd.end(), {
+            "shell", "CLASSPATH=/data/local/tmp/scrcpy-server-manual.jar",
             "app_process", "/", "com.genymobile.scrcpy.Server 3.3.4",
             "tunnel_forward=true", "audio=false", "video=false", "cleanup=false",
             "send_device_meta=false", "send_frame_meta=false", "send_dummy_byte=true",
             NULL
-        };
+        });
         int result = subprocess_create(
-            cmd,
+            cmd.data(),
             subprocess_option_inherit_environment | subprocess_option_search_user_path | subprocess_option_enable_async,
             process
         );
@@ -91,12 +146,18 @@ namespace {
         buf[0] = value >> 8;
         buf[1] = value;
     }
+
+    void write64(uint8_t* buf, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            buf[i] = value >> (56 - 8 * i);
+        }
+    }
 }   // namespace
 
 // internal class
 class ControlSessionInternal {
 public:
-    ControlSessionInternal(uint16_t screen_width, uint16_t screen_height) : socket_(io_context_) {
+    ControlSessionInternal(uint16_t screen_width, uint16_t screen_height, const Device& device) : socket_(io_context_) {
         // initialize screen sizes
         screen_size_.width = screen_width;
         screen_size_.height = screen_height;
@@ -105,11 +166,11 @@ public:
         screen_size_.h[0] = screen_height >> 8;
         screen_size_.h[1] = screen_height;
         // initialize server
-        pushServer();
-        runServer(&server_process_);
+        pushServer(device);
+        runServer(device, &server_process_);
         try {
             tcp::resolver resolver(io_context_);
-            auto endpoints = resolver.resolve("127.0.0.1", STR(SCRCPY_CLIENT_PORT));
+            auto endpoints = resolver.resolve("127.0.0.1", std::to_string(device.port));
             // connect to server
             while (true) {
                 asio::connect(socket_, endpoints);
@@ -139,27 +200,89 @@ public:
 
 public:
     void tap(uint16_t x, uint16_t y, std::chrono::milliseconds duration) {
+        // send touch down event
+        touch(kActionDown, kPointerIds[0], x, y);
+        // small delay
+        std::this_thread::sleep_for(duration);
+        // send touch up event
+        touch(kActionUp, kPointerIds[0], x, y);
+    }
+
+    void pan(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, std::chrono::milliseconds duration) {
+        // fingers are placed horizontally symmetric around the points
+        const double d = kPanFingerDistance / 2.0;
+        moveFingers({{{x1 - d, (double)y1, x2 - d, (double)y2}, {x1 + d, (double)y1, x2 + d, (double)y2}}}, duration);
+    }
+
+    void pinch(uint16_t x, uint16_t y, uint16_t distance, double scale, std::chrono::milliseconds duration) {
+        // fingers are placed horizontally symmetric around the center
+        const double d1 = distance / 2.0;
+        const double d2 = distance * scale / 2.0;
+        moveFingers({{{x - d1, (double)y, x - d2, (double)y}, {x + d1, (double)y, x + d2, (double)y}}}, duration);
+    }
+
+private:
+    static constexpr uint8_t kActionDown = 0x00;   // AMOTION_EVENT_ACTION_DOWN
+    static constexpr uint8_t kActionUp = 0x01;     // AMOTION_EVENT_ACTION_UP
+    static constexpr uint8_t kActionMove = 0x02;   // AMOTION_EVENT_ACTION_MOVE
+    // ids of the fingers, the first one is used for taps
+    static constexpr uint64_t kPointerIds[] = {0x1234567887654321, 0x1234567887654322};
+    // interval between move events of the gestures
+    static constexpr std::chrono::milliseconds kMoveInterval = 10ms;
+    // time the fingers are held still before release at the end of the gestures
+    static constexpr std::chrono::milliseconds kHoldDuration = 150ms;
+    // distance between the fingers of two finger drags
+    static constexpr int kPanFingerDistance = 100;
+
+    // straight path of a finger from (x1, y1) to (x2, y2)
+    struct FingerPath {
+        double x1, y1, x2, y2;
+    };
+
+    // put two fingers down, move them along their paths at the same time and release
+    void moveFingers(const std::array<FingerPath, 2>& paths, std::chrono::milliseconds duration) {
+        // fingers can't go beyond the screen
+        auto touchAt = [&](uint8_t action, int i_finger, double t) {
+            const FingerPath& path = paths[i_finger];
+            double x = std::clamp(path.x1 + (path.x2 - path.x1) * t, 0.0, screen_size_.width - 1.0);
+            double y = std::clamp(path.y1 + (path.y2 - path.y1) * t, 0.0, screen_size_.height - 1.0);
+            touch(action, kPointerIds[i_finger], x, y);
+        };
+        // the server translates the second touch down into ACTION_POINTER_DOWN by itself
+        for (int i_finger = 0; i_finger < 2; i_finger++) {
+            touchAt(kActionDown, i_finger, 0);
+        }
+        const int steps = std::max<int>(1, duration / kMoveInterval);
+        for (int i = 1; i <= steps; i++) {
+            std::this_thread::sleep_for(kMoveInterval);
+            for (int i_finger = 0; i_finger < 2; i_finger++) {
+                touchAt(kActionMove, i_finger, (double)i / steps);
+            }
+        }
+        // hold the fingers still, otherwise the application scrolls further by inertia
+        std::this_thread::sleep_for(kHoldDuration);
+        for (int i_finger = 0; i_finger < 2; i_finger++) {
+            touchAt(kActionUp, i_finger, 1);
+        }
+    }
+
+    void touch(uint8_t action, uint64_t pointer_id, uint16_t x, uint16_t y) {
         // buf is serialized data that is sent to the server
         // https://github.com/Genymobile/scrcpy/blob/master/app/tests/test_control_msg_serialize.c
         uint8_t buf[] = {
             0x02, // SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT
-            0x00, // AKEY_EVENT_ACTION_DOWN
-            0x12, 0x34, 0x56, 0x78, 0x87, 0x65, 0x43, 0x21, // pointer id
+            action,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // pointer id
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // touch position: x[12, 13] y[16, 17]
             screen_size_.w[0], screen_size_.w[1], screen_size_.h[0], screen_size_.h[1], // screen size
             0xff, 0xff, // pressure
             0x00, 0x00, 0x00, 0x01, // AMOTION_EVENT_BUTTON_PRIMARY (action button)
             0x00, 0x00, 0x00, 0x01, // AMOTION_EVENT_BUTTON_PRIMARY (buttons)
         };
-        // write x and y positions to buf
+        // write pointer id, x and y positions to buf
+        write64(buf + 2, pointer_id);
         write16(buf + 12, x);
         write16(buf + 16, y);
-        // send touch down event
-        asio::write(socket_, asio::buffer(buf));
-        // small delay
-        std::this_thread::sleep_for(duration);
-        // send touch up event
-        buf[1] = 0x01; // AKEY_EVENT_ACTION_UP
         asio::write(socket_, asio::buffer(buf));
     }
 
@@ -182,8 +305,8 @@ private:
 };
 
 
-ControlSession::ControlSession(uint16_t screen_width, uint16_t screen_height)
-    : internal_(std::make_unique<ControlSessionInternal>(screen_width, screen_height)) {}
+ControlSession::ControlSession(uint16_t screen_width, uint16_t screen_height, const Device& device)
+    : internal_(std::make_unique<ControlSessionInternal>(screen_width, screen_height, device)) {}
 
 ControlSession::~ControlSession() {}
 
@@ -194,4 +317,23 @@ void ControlSession::tap(uint16_t x, uint16_t y, std::chrono::milliseconds durat
         return;
 
     internal_->tap(x, y, duration);
+    tap_count_++;
+}
+
+void ControlSession::pan(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, std::chrono::milliseconds duration) {
+    if (!internal_)
+        return;
+
+    internal_->pan(x1, y1, x2, y2, duration);
+}
+
+void ControlSession::pinch(uint16_t x, uint16_t y, uint16_t distance, double scale, std::chrono::milliseconds duration) {
+    if (!internal_)
+        return;
+
+    internal_->pinch(x, y, distance, scale, duration);
+}
+
+int ControlSession::tapCount() const {
+    return tap_count_;
 }
@@ -3,6 +3,8 @@
 #include <chrono>
 #include <memory>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 #define SCRCPY_CLIENT_PORT 1234
 
@@ -10,12 +12,22 @@ using namespace std::literals;
 using std::uint16_t;
 using std::uint8_t;
 
+// android device connected via adb
+struct Device {
+    // serial number as listed by `adb devices`, may be empty when only one device is connected
+    std::string serial;
+    // local port forwarded to the scrcpy server on the device, must be unique for every device
+    uint16_t port = SCRCPY_CLIENT_PORT;
+};
+
 namespace adb {
+    // returns serial numbers of all connected devices
+    std::vector<std::string> listDevices();
     // returns true if device is connected, false otherwise
     bool checkDevice();
 
-    // take a screenshot
-    void takeScreenshot();
+    // take a screenshot and return it as png data
+    std::vector<uint8_t> takeScreenshot(const Device& device);
 
     /*
      * NOTE:
@@ -25,16 +37,16 @@ namespace adb {
      */
 
     // do a single tap
-    void tap(unsigned x, unsigned y);
+    void tap(const Device& device, unsigned x, unsigned y);
     // do a swipe from one point to another
-    void swipe(unsigned x1, unsigned y1, unsigned x2, unsigned y2, std::chrono::milliseconds duration);
+    void swipe(const Device& device, unsigned x1, unsigned y1, unsigned x2, unsigned y2, std::chrono::milliseconds duration);
 
 }   // namespace adb
 
 class ControlSessionInternal;
 class ControlSession {
 public:
-    ControlSession(uint16_t screen_width, uint16_t screen_height);
+    ControlSession(uint16_t screen_width, uint16_t screen_height, const Device& device = {});
     // disabled copy and move operations
     ControlSession(const ControlSession&) = delete;
     ControlSession& operator=(const ControlSession&) = delete;
@@ -48,7 +60,18 @@ public:
 public:
     // do a single tap
     void tap(uint16_t x, uint16_t y, std::chrono::milliseconds duration = 5ms);
+    // drag the view with two fingers from one point to another
+    // one finger drags would paint cells on the grid, two fingers only move it.
+    // fingers are held still at the end point for a while before release, so the drag doesn't turn into a fling
+    void pan(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, std::chrono::milliseconds duration = 300ms);
+    // zoom with two fingers around the point (x, y)
+    // fingers start `distance` pixels apart and end `distance * scale` pixels apart (scale > 1 zooms in)
+    void pinch(uint16_t x, uint16_t y, uint16_t distance, double scale, std::chrono::milliseconds duration = 400ms);
+
+    // number of taps done during the session
+    int tapCount() const;
 
 private:
     std::unique_ptr<ControlSessionInternal> internal_;
+    int tap_count_ = 0;
 };
@@ -0,0 +1,68 @@
+#include "device_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "controls.h"
+
+namespace {
+    // result of the job on a single device
+    struct DeviceResult {
+        double seconds = 0;
+        int tap_count = 0;
+        // empty on success
+        std::string error;
+    };
+}
+
+int runDevicePool(const std::function<void(Screen&)>& job) {
+    std::vector<std::string> serials = adb::listDevices();
+    std::cout << std::format("running on {} devices", serials.size()) << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<DeviceResult> results(serials.size());
+    {
+        std::vector<std::jthread> threads;
+        for (size_t i = 0; i < serials.size(); i++) {
+            threads.emplace_back([&, i] {
+                // every device needs its own forwarded port
+                Device device{serials[i], uint16_t(SCRCPY_CLIENT_PORT + i)};
+                auto device_start = std::chrono::steady_clock::now();
+                try {
+                    Screen screen(device);
+                    job(screen);
+                    results[i].tap_count = screen.tapCount();
+                } catch (std::exception& e) {
+                    results[i].error = e.what();
+                }
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - device_start;
+                results[i].seconds = elapsed.count();
+            });
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // report
+    int failed_count = 0;
+    int total_tap_count = 0;
+    for (size_t i = 0; i < serials.size(); i++) {
+        const DeviceResult& result = results[i];
+        if (result.error.empty()) {
+            std::cout << std::format("{}: done in {:.2f}s, {} taps", serials[i], result.seconds, result.tap_count) << std::endl;
+        } else {
+            std::cout << std::format("{}: failed in {:.2f}s: {}", serials[i], result.seconds, result.error) << std::endl;
+            failed_count++;
+        }
+        total_tap_count += result.tap_count;
+    }
+    const double seconds = std::max(elapsed.count(), 1e-9);
+    std::cout << std::format("total: {} of {} devices done in {:.2f}s, {:.1f} taps/s, {:.1f} puzzles/min",
+                             serials.size() - failed_count, serials.size(), elapsed.count(),
+                             total_tap_count / seconds, (serials.size() - failed_count) * 60 / seconds) << std::endl;
+    return failed_count;
+}
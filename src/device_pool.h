@@ -0,0 +1,11 @@
+#pragma once
+
+#include <functional>
+
+#include "screen.h"
+
+// run the job on every connected device at once, each device on its own thread
+// every device gets its own scrcpy port, control session, screen and answer buffers
+// prints timing of every device and the total throughput
+// returns the number of devices the job has failed on
+int runDevicePool(const std::function<void(Screen&)>& job);
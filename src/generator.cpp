@@ -0,0 +1,72 @@
+#include "generator.h"
+
+#include <random>
+
+#include "solver.h"
+
+namespace {
+    std::vector<int> generateRandom(const GeneratorOptions& options, std::mt19937& rng) {
+        std::bernoulli_distribution is_filled(options.density);
+        std::uniform_int_distribution<int> color(1, options.color_count);
+        std::vector<int> colors(options.width * options.height, 0);
+        for (int& cell : colors) {
+            if (is_filled(rng)) {
+                cell = color(rng);
+            }
+        }
+        return colors;
+    }
+
+    std::vector<int> generateStructured(const GeneratorOptions& options, std::mt19937& rng) {
+        // give up on shapes when the density can't be reached (e.g. when shapes overlap too much)
+        constexpr int kMaxShapeCount = 1000;
+        const int width = options.width;
+        const int height = options.height;
+        const int target_count = options.density * width * height;
+        std::uniform_int_distribution<int> color(1, options.color_count);
+        std::uniform_int_distribution<int> col(0, width - 1);
+        std::uniform_int_distribution<int> row(0, height - 1);
+        std::uniform_int_distribution<int> half_width(1, std::max(1, width / 4));
+        std::uniform_int_distribution<int> half_height(1, std::max(1, height / 4));
+        std::bernoulli_distribution is_ellipse(0.5);
+
+        std::vector<int> colors(width * height, 0);
+        int filled_count = 0;
+        for (int i = 0; i < kMaxShapeCount && filled_count < target_count; i++) {
+            const int shape_color = color(rng);
+            const int center_x = col(rng);
+            const int center_y = row(rng);
+            const int a = half_width(rng);
+            const int b = half_height(rng);
+            const bool ellipse = is_ellipse(rng);
+            for (int y = std::max(0, center_y - b); y <= std::min(height - 1, center_y + b); y++) {
+                for (int x = std::max(0, center_x - a); x <= std::min(width - 1, center_x + a); x++) {
+                    const double dx = (double)(x - center_x) / a;
+                    const double dy = (double)(y - center_y) / b;
+                    if (ellipse && dx * dx + dy * dy > 1.0)
+                        continue;
+                    int& cell = colors[y * width + x];
+                    filled_count += (cell == 0);
+                    cell = shape_color;
+                }
+            }
+        }
+        return colors;
+    }
+}
+
+GeneratedNonogram generateNonogram(const GeneratorOptions& options) {
+    std::mt19937 rng(options.seed);
+    GeneratedNonogram result;
+    if (options.kind == GeneratorOptions::Kind::kRandom) {
+        result.solution = generateRandom(options, rng);
+    } else {
+        result.solution = generateStructured(options, rng);
+    }
+    result.nonogram = Nonogram::fromSolution(options.width, options.height, options.color_count, result.solution);
+    return result;
+}
+
+bool isUnique(const Nonogram& nonogram) {
+    return Solver(nonogram).countSolutions(2) == 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "nonogram.h"
+
+// parameters of the generated puzzles
+struct GeneratorOptions {
+    enum class Kind {
+        // every cell is filled independently
+        kRandom,
+        // picture made of overlapping rectangles and ellipses, closer to the real puzzles
+        kStructured,
+    };
+
+    Kind kind = Kind::kRandom;
+    int width = 20;
+    int height = 20;
+    // fraction of the filled cells
+    double density = 0.5;
+    // number of colors except the background, 1 for black and white
+    int color_count = 1;
+    std::uint32_t seed = 0;
+};
+
+// generated puzzle together with the picture its clues were made from
+struct GeneratedNonogram {
+    Nonogram nonogram;
+    // colors of the cells in row-major order, 0 is the background
+    std::vector<int> solution;
+};
+
+// generate a random puzzle
+// the puzzle always has the generated picture as a solution, but it's not necessarily the only one
+GeneratedNonogram generateNonogram(const GeneratorOptions& options);
+
+// check that the puzzle has exactly one solution
+bool isUnique(const Nonogram& nonogram);
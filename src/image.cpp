@@ -1,9 +1,13 @@
 #include "image.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <opencv2/imgcodecs.hpp>
 
-#include "controls.h"
+ImageError::ImageError(const std::string& what, std::string file_name, cv::Mat image)
+    : std::runtime_error(what), file_name_(std::move(file_name)), image_(std::move(image)) {}
 
 Image::Image() {}
 
@@ -11,17 +15,145 @@ Image::Image(const cv::Mat& mat) : mat_(mat) {}
 
 Image::Image(const cv::Mat& mat, const cv::Rect& rect) : mat_(mat), rect_(rect) {}
 
-Image Image::fromScreenshot() {
-    cv::Mat image = cv::imread("screenshot.png");
-    return Image(std::move(image));
+Image Image::fromScreenshot(const std::vector<uint8_t>& png, ImageBuffers* buffers) {
+    cv::Mat image;
+    if (buffers) {
+        // reuses the memory of the previous screenshot if the resolution is the same
+        cv::Mat& buffer = buffers->buffer(ImageBuffers::Buffer::kScreenshot);
+        cv::imdecode(png, cv::IMREAD_COLOR_BGR, &buffer);
+        image = buffer;
+    } else {
+        image = cv::imdecode(png, cv::IMREAD_COLOR_BGR);
+    }
+    if (image.empty()) {
+        throw std::runtime_error("error: unable to decode screenshot");
+    }
+    Image res(std::move(image));
+    res.buffers_ = buffers;
+    return res;
 }
 
-Image Image::fromBitmap(bool is_colored) {
-    cv::Mat image = cv::imread("bitmap.bmp", (is_colored ? cv::IMREAD_COLOR_BGR : cv::IMREAD_GRAYSCALE));
+Image Image::fromBitmap(const std::string& path, bool is_colored) {
+    cv::Mat image = cv::imread(path, (is_colored ? cv::IMREAD_COLOR_BGR : cv::IMREAD_GRAYSCALE));
+    if (image.empty()) {
+        throw std::runtime_error("error: unable to load answer from " + path);
+    }
     return Image(std::move(image));
 }
 
-void Image::saveToBitmap(int nonogram_width, int nonogram_height, bool is_colored, const std::vector<int>& margins) {
+IndexedBitmap indexColors(const cv::Mat& bitmap) {
+    IndexedBitmap res;
+    res.indices.create(bitmap.size(), CV_32SC1);
+    for (int row = 0; row < bitmap.rows; row++) {
+        for (int col = 0; col < bitmap.cols; col++) {
+            const cv::Vec3b& color = bitmap.at<cv::Vec3b>(row, col);
+            // clustered bitmaps have just a few colors, so linear search is fine
+            auto it = std::find(res.colors.begin(), res.colors.end(), color);
+            if (it == res.colors.end()) {
+                it = res.colors.insert(it, color);
+            }
+            res.indices.at<int>(row, col) = it - res.colors.begin();
+        }
+    }
+    return res;
+}
+
+namespace {
+    double distanceSq(const float* a, const float* b) {
+        double res = 0;
+        for (int c = 0; c < 3; c++) {
+            res += (a[c] - b[c]) * (a[c] - b[c]);
+        }
+        return res;
+    }
+
+    // group similar colors together with k-means, `samples` is CV_32FC1 matrix with a BGR color per row
+    // if `color_count` is 0, clusters are added until every sample of a color is close enough to its center,
+    // where colors are the clusters that have at least a few samples. Samples of smaller clusters are outliers
+    // (anti-aliased cells on the edges of the picture), they're given to the closest color
+    // returns cluster centers, `labels` are set to the cluster index of every sample
+    std::vector<cv::Vec3b> clusterColors(const cv::Mat& samples, int color_count, cv::Mat& labels) {
+        // colors of the cells inside one cluster are expected to differ only because of image scaling.
+        // the farthest sample is checked rather than the average, otherwise a color of a few cells is merged into
+        // a neighbor one
+        constexpr double kMaxDistanceSq = 32.0 * 32.0;
+        // anti-aliased cells rarely come out the same, while even a rare color of the picture has several cells
+        constexpr int kMinColorSize = 4;
+        constexpr int kMaxColorCount = 32;
+        constexpr int kAttemptCount = 3;
+        const cv::TermCriteria criteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 0.5);
+        // same answer gives same clusters
+        cv::setRNGSeed(1);
+
+        cv::Mat centers;
+        if (color_count > 0) {
+            cv::kmeans(samples, std::min(color_count, samples.rows), labels, criteria, kAttemptCount, cv::KMEANS_PP_CENTERS, centers);
+        } else {
+            std::vector<bool> is_color;
+            for (int k = 1; k <= std::min(kMaxColorCount, samples.rows); k++) {
+                cv::kmeans(samples, k, labels, criteria, kAttemptCount, cv::KMEANS_PP_CENTERS, centers);
+                std::vector<int> sizes(k, 0);
+                for (int i = 0; i < samples.rows; i++) {
+                    sizes[labels.at<int>(i)]++;
+                }
+                is_color.resize(k);
+                for (int i = 0; i < k; i++) {
+                    is_color[i] = (sizes[i] >= std::min(kMinColorSize, samples.rows));
+                }
+                double max_distance_sq = 0;
+                for (int i = 0; i < samples.rows; i++) {
+                    const int label = labels.at<int>(i);
+                    if (is_color[label]) {
+                        max_distance_sq = std::max(max_distance_sq, distanceSq(samples.ptr<float>(i), centers.ptr<float>(label)));
+                    }
+                }
+                const bool has_colors = std::find(is_color.begin(), is_color.end(), true) != is_color.end();
+                if (has_colors && max_distance_sq <= kMaxDistanceSq)
+                    break;
+            }
+            // tiny pictures may have no cluster big enough
+            if (std::find(is_color.begin(), is_color.end(), true) == is_color.end()) {
+                is_color.assign(is_color.size(), true);
+            }
+
+            // keep only the colors and give the outliers to the closest ones
+            std::vector<int> color_indices(centers.rows, -1);
+            cv::Mat color_centers;
+            for (int i = 0; i < centers.rows; i++) {
+                if (is_color[i]) {
+                    color_indices[i] = color_centers.rows;
+                    color_centers.push_back(centers.row(i));
+                }
+            }
+            for (int i = 0; i < samples.rows; i++) {
+                int& label = labels.at<int>(i);
+                if (color_indices[label] >= 0) {
+                    label = color_indices[label];
+                    continue;
+                }
+                const float* sample = samples.ptr<float>(i);
+                double min_distance_sq = std::numeric_limits<double>::max();
+                for (int j = 0; j < color_centers.rows; j++) {
+                    const double distance_sq = distanceSq(sample, color_centers.ptr<float>(j));
+                    if (distance_sq < min_distance_sq) {
+                        min_distance_sq = distance_sq;
+                        label = j;
+                    }
+                }
+            }
+            centers = color_centers;
+        }
+
+        std::vector<cv::Vec3b> colors(centers.rows);
+        for (int i = 0; i < centers.rows; i++) {
+            const float* center = centers.ptr<float>(i);
+            colors[i] = cv::Vec3b(cv::saturate_cast<uchar>(center[0]), cv::saturate_cast<uchar>(center[1]), cv::saturate_cast<uchar>(center[2]));
+        }
+        return colors;
+    }
+}
+
+Image Image::toBitmap(int nonogram_width, int nonogram_height, bool is_colored, const std::vector<int>& margins, int color_count) {
     const int width = mat_.cols;
     const int height = mat_.rows;
     // update nonogram sizes according to margins
@@ -32,9 +164,14 @@ void Image::saveToBitmap(int nonogram_width, int nonogram_height, bool is_colore
     const double cell_height = (double)height / nonogram_height;
 
     // make mask to be able to skip bg cells
-    cv::Mat mask = getMask().reduceNoise().mat_;
+    cv::Mat mask = getMask(240, false, ImageBuffers::Mask::kBitmap).reduceNoise().mat_;
     // fill result bitmap
     cv::Mat bitmap(nonogram_height, nonogram_width, CV_8UC3, cv::Scalar(255, 255, 255));
+    // colored cells are sampled first and get their colors after clustering
+    cv::Mat samples;
+    if (is_colored) {
+        samples.create(nonogram_width * nonogram_height, 3, CV_32FC1);
+    }
     double x = cell_width / 2;
     double y = cell_height / 2;
     for (int row = 0; row < nonogram_height; row++) {
@@ -50,7 +187,10 @@ void Image::saveToBitmap(int nonogram_width, int nonogram_height, bool is_colore
                     cv::Point(x + cell_width / 3.0, y + cell_width / 3.0)
                 );
                 cv::Scalar avg_color = cv::mean(mat_(cell_rect));
-                bitmap.at<cv::Vec3b>(row, col) = cv::Vec3b(avg_color[0], avg_color[1], avg_color[2]);
+                float* sample = samples.ptr<float>(row * nonogram_width + col);
+                sample[0] = avg_color[0];
+                sample[1] = avg_color[1];
+                sample[2] = avg_color[2];
             } else {
                 // skip white cells
                 if (mask.at<uchar>(point)) {
@@ -61,6 +201,16 @@ void Image::saveToBitmap(int nonogram_width, int nonogram_height, bool is_colore
         }
         y += cell_height;
     }
+    if (is_colored) {
+        cv::Mat labels;
+        std::vector<cv::Vec3b> colors = clusterColors(samples, color_count, labels);
+        std::cout << "number of answer colors: " << colors.size() << std::endl;
+        for (int row = 0; row < nonogram_height; row++) {
+            for (int col = 0; col < nonogram_width; col++) {
+                bitmap.at<cv::Vec3b>(row, col) = colors[labels.at<int>(row * nonogram_width + col)];
+            }
+        }
+    }
 
     // write white margins directly into bitmap so we don't need to handle them during painting
     cv::copyMakeBorder(bitmap, bitmap, margins[1], margins[3], margins[0], margins[2], cv::BORDER_CONSTANT, cv::Vec3b(255, 255, 255));
@@ -68,23 +218,23 @@ void Image::saveToBitmap(int nonogram_width, int nonogram_height, bool is_colore
     // for debugging
     // cv::imwrite("mask.png", mask);
 
-    // saving
-    cv::imwrite("bitmap.bmp", bitmap);
+    return Image(std::move(bitmap));
 }
 
-Image Image::getMask(int thresh, bool is_inverted) {
+Image Image::getMask(int thresh, bool is_inverted, ImageBuffers::Mask slot) {
+    ImageBuffers& buffers = this->buffers();
     // create mask on grayscale image
-    cv::Mat gray;
+    cv::Mat& gray = buffers.gray(slot);
     cv::cvtColor(mat_, gray, cv::COLOR_BGR2GRAY);
     // create mask
-    cv::Mat mask;
+    cv::Mat& mask = buffers.mask(slot);
     int threshold_type = (is_inverted ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY);
     cv::threshold(gray, mask, thresh, 255, threshold_type);
-    return Image(std::move(mask));
+    return derive(mask);
 }
 
 Image Image::reduceNoise() {
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(7, 7));
+    const cv::Mat& kernel = buffers().structuringElement(cv::MORPH_RECT, cv::Size(7, 7));
     cv::morphologyEx(mat_, mat_, cv::MORPH_CLOSE, kernel);
     cv::morphologyEx(mat_, mat_, cv::MORPH_OPEN, kernel);
     return *this;
@@ -102,7 +252,7 @@ Image Image::extractAnswer() {
     const int width = mat_.cols;
     const int height = mat_.rows;
     // crop to canvas
-    cv::Mat mask = getMask().reduceNoise().mat_;
+    cv::Mat mask = getMask(240, false, ImageBuffers::Mask::kAnswer).reduceNoise().mat_;
     cv::Rect bounding_box_canvas = cv::boundingRect(mask);
     // shrink it further to remove remaining pixel noise on borders
     bounding_box_canvas.x += 2;
@@ -117,15 +267,12 @@ Image Image::extractAnswer() {
     cv::Rect bounding_box_picture = cv::boundingRect(mask);
     cv::Mat picture = canvas(bounding_box_picture);
 
-    return Image(
-        std::move(picture),
-        toAbsoluteRect(bounding_box_canvas, bounding_box_picture)
-    );
+    return derive(picture, toAbsoluteRect(bounding_box_canvas, bounding_box_picture));
 }
 
 Image Image::extractNonogram() {
     constexpr int kDarkestPaperPixelGrayValue = 230;
-    Image mask_image = getMask(kDarkestPaperPixelGrayValue);
+    Image mask_image = getMask(kDarkestPaperPixelGrayValue, false, ImageBuffers::Mask::kNonogram);
     cv::Mat mask = mask_image.mat_;
     // reduce noise on white regions
     // cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(7, 5));
@@ -136,9 +283,10 @@ Image Image::extractNonogram() {
      *  the nonogram is too tall it sticks to the top-bottom borders,
      *  we should go for vertical lines instead
      */
-    cv::Mat horizontal = mask.clone();
+    cv::Mat& horizontal = buffers().buffer(ImageBuffers::Buffer::kNonogramLines);
+    mask.copyTo(horizontal);
     const int horizontal_size = mat_.cols;
-    cv::Mat horizontal_structure = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(horizontal_size, 1));
+    const cv::Mat& horizontal_structure = buffers().structuringElement(cv::MORPH_RECT, cv::Size(horizontal_size, 1));
     cv::erode(horizontal, horizontal, horizontal_structure);
 
     // for debugging
@@ -148,19 +296,16 @@ Image Image::extractNonogram() {
     // get canvas bounding box
     cv::Rect bounding_box_canvas = cv::boundingRect(horizontal);
     if (bounding_box_canvas.area() == 0) {
-        cv::imwrite("mask.png", mask);
-        throw std::runtime_error("error: unable to extract canvas");
+        // the mask lives in the image buffers, which are reused
+        throw ImageError("error: unable to extract canvas", "mask.png", mask.clone());
     }
 
     // remove white margins
     cv::Mat canvas = mat_(bounding_box_canvas);
-    mask = Image(canvas).getMask(100, true).mat_;
+    mask = derive(canvas).getMask(100, true, ImageBuffers::Mask::kCanvas).mat_;
     cv::Rect bounding_box_nonogram = cv::boundingRect(mask);
 
-    return Image(
-        std::move(canvas(bounding_box_nonogram)),
-        toAbsoluteRect(bounding_box_canvas, bounding_box_nonogram)
-    );
+    return derive(canvas(bounding_box_nonogram), toAbsoluteRect(bounding_box_canvas, bounding_box_nonogram));
 }
 
 namespace {
@@ -215,7 +360,7 @@ namespace {
 
 Image Image::extractGrid(cv::Vec3b& bg_color, int width, int height) {
     constexpr int kDarkestPaperPixelGrayValue = 220;
-    cv::Mat mask = getMask(kDarkestPaperPixelGrayValue).mat_;
+    cv::Mat mask = getMask(kDarkestPaperPixelGrayValue, false, ImageBuffers::Mask::kGrid).mat_;
 
     // extract preview rect
     // instead of extracting lines and taking bounding rect,
@@ -237,8 +382,7 @@ Image Image::extractGrid(cv::Vec3b& bg_color, int width, int height) {
     // cv::imwrite("mask.png", mask);
 
     if (bounding_box_preview.area() == 0) {
-        cv::imwrite("mask.png", mask);
-        throw std::runtime_error("error: unable to extract preview rect");
+        throw ImageError("error: unable to extract preview rect", "mask.png", mask.clone());
     }
 
     // by default the preview is filled with background color
@@ -262,11 +406,10 @@ Image Image::extractGrid(cv::Vec3b& bg_color, int width, int height) {
     cv::Rect bounding_box_grid(grid_x, grid_y, grid_width, grid_height);
 
     if (bounding_box_grid.area() == 0) {
-        cv::imwrite("preview.png", mat_(bounding_box_preview));
-        throw std::runtime_error("error: unable to extract grid");
+        throw ImageError("error: unable to extract grid", "preview.png", mat_(bounding_box_preview).clone());
     }
 
-    return Image(mat_(bounding_box_grid), toAbsoluteRect(rect_, bounding_box_grid));
+    return derive(mat_(bounding_box_grid), toAbsoluteRect(rect_, bounding_box_grid));
 }
 
 namespace {
@@ -297,13 +440,16 @@ Image Image::extractPalette(std::vector<cv::Vec3b>& palette_colors, std::vector<
         cv::Point(mat_.cols, mat_.rows)
     );
     // get rid of lower black control panel
-    cv::Mat mask = Image(mat_(working_rect)).getMask(100).mat_;
+    ImageBuffers& buffers = this->buffers();
+    cv::Mat mask = derive(mat_(working_rect)).getMask(100, false, ImageBuffers::Mask::kPalette).mat_;
     cv::Rect bounding_box_interface = cv::boundingRect(mask);
-    mask = ~mask(bounding_box_interface);
+    cv::bitwise_not(mask(bounding_box_interface), buffers.buffer(ImageBuffers::Buffer::kPaletteInverted));
+    mask = buffers.buffer(ImageBuffers::Buffer::kPaletteInverted);
     working_rect = toAbsoluteRect(working_rect, bounding_box_interface);
     // find black horizontal lines on top and bottom of the palette
-    cv::Mat horizontal = mask.clone();
-    cv::Mat horizontal_structure = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(mask.cols, 1));
+    cv::Mat& horizontal = buffers.buffer(ImageBuffers::Buffer::kPaletteLines);
+    mask.copyTo(horizontal);
+    const cv::Mat& horizontal_structure = buffers.structuringElement(cv::MORPH_RECT, cv::Size(mask.cols, 1));
     cv::erode(horizontal, horizontal, horizontal_structure);
     // get bounding box of the palette
     cv::Rect bounding_box_palette = cv::boundingRect(horizontal);
@@ -312,11 +458,14 @@ Image Image::extractPalette(std::vector<cv::Vec3b>& palette_colors, std::vector<
 
     // *** PARSE THE PALETTE COLORS
     // find black vertical lines that divide the color blocks
-    cv::Mat vertical = mask.clone();
-    cv::Mat vertical_structure = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(1, mask.rows));
+    cv::Mat& vertical = buffers.buffer(ImageBuffers::Buffer::kPaletteVertical);
+    mask.copyTo(vertical);
+    const cv::Mat& vertical_structure = buffers.structuringElement(cv::MORPH_RECT, cv::Size(1, mask.rows));
     cv::erode(vertical, vertical, vertical_structure);
     // remove first and last thick lines
-    bounding_box_palette = cv::boundingRect(~vertical);
+    cv::Mat& vertical_inverted = buffers.buffer(ImageBuffers::Buffer::kPaletteVerticalInverted);
+    cv::bitwise_not(vertical, vertical_inverted);
+    bounding_box_palette = cv::boundingRect(vertical_inverted);
     working_rect = toAbsoluteRect(working_rect, bounding_box_palette);
     // count the number of vetical lines
     int color_count = getNumberOfVerticalLines(vertical) - 1;
@@ -343,5 +492,80 @@ Image Image::extractPalette(std::vector<cv::Vec3b>& palette_colors, std::vector<
         color_coords[i_color] = {(int)x + working_rect.x, (int)y + working_rect.y};
     }
 
-    return Image(palette, working_rect);
+    return derive(palette, working_rect);
+}
+
+namespace {
+    // find equally spaced lines that fit the projection of the line pixels best
+    // `origin` is the position of line 0 and `pitch` is the distance between lines, both are updated in place
+    void fitLines(const std::vector<int>& projection, double& origin, double& pitch) {
+        // the zoom level after pinching is not exact
+        constexpr double kPitchTolerance = 0.15;
+        constexpr double kPitchStep = 0.1;
+        constexpr double kShiftStep = 0.5;
+        const int size = projection.size();
+        // fit relative to the line closest to the center of the projection,
+        // otherwise a small change of pitch would move visible lines too much when the origin is far away
+        const int k_anchor = std::round((size / 2.0 - origin) / pitch);
+        const double anchor = origin + k_anchor * pitch;
+
+        double best_score = -1;
+        double best_anchor = anchor;
+        double best_pitch = pitch;
+        for (double p = pitch * (1 - kPitchTolerance); p <= pitch * (1 + kPitchTolerance); p += kPitchStep) {
+            for (double shift = -p / 2; shift < p / 2; shift += kShiftStep) {
+                const double a = anchor + shift;
+                // average projection value on all the lines within the image
+                double sum = 0;
+                int count = 0;
+                for (double pos = a - std::floor(a / p) * p; pos < size; pos += p) {
+                    sum += projection[(int)pos];
+                    count++;
+                }
+                const double score = (count ? sum / count : 0);
+                if (score > best_score) {
+                    best_score = score;
+                    best_anchor = a;
+                    best_pitch = p;
+                }
+            }
+        }
+        origin = best_anchor - k_anchor * best_pitch;
+        pitch = best_pitch;
+    }
+}
+
+void Image::refineGrid(cv::Point2d& origin, cv::Size2d& cell_size, cv::Rect area) {
+    // grid lines are darker than the paper
+    constexpr int kLightestLinePixelGrayValue = 200;
+    area &= cv::Rect(0, 0, mat_.cols, mat_.rows);
+    cv::Mat mask = derive(mat_(area)).getMask(kLightestLinePixelGrayValue, true, ImageBuffers::Mask::kRefine).mat_;
+    // project line pixels onto both axes
+    std::vector<int> columns(mask.cols, 0);
+    std::vector<int> rows(mask.rows, 0);
+    for (int row = 0; row < mask.rows; row++) {
+        const uchar* ptr = mask.ptr<uchar>(row);
+        for (int col = 0; col < mask.cols; col++) {
+            if (ptr[col]) {
+                columns[col]++;
+                rows[row]++;
+            }
+        }
+    }
+    // fit vertical and horizontal lines separately in coordinates of the area
+    double x = origin.x - area.x;
+    double y = origin.y - area.y;
+    fitLines(columns, x, cell_size.width);
+    fitLines(rows, y, cell_size.height);
+    origin = cv::Point2d(x + area.x, y + area.y);
+}
+
+ImageBuffers& Image::buffers() const {
+    return (buffers_ ? *buffers_ : ImageBuffers::forThread());
+}
+
+Image Image::derive(const cv::Mat& mat, const cv::Rect& rect) const {
+    Image res(mat, rect);
+    res.buffers_ = buffers_;
+    return res;
 }
@@ -1,10 +1,38 @@
 #pragma once
 
+#include "image_buffers.h"
+
+#include <cstdint>
 #include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+// failure of image processing that comes with an image showing what went wrong
+// the image isn't saved here, so the catcher can put it into a file of its own, see `Screen::saveErrorImage()`
+class ImageError : public std::runtime_error {
+public:
+    ImageError(const std::string& what, std::string file_name, cv::Mat image);
+
+public:
+    // suggested file name, e.g. `mask.png`
+    std::string file_name_;
+    cv::Mat image_;
+};
+
+// bitmap with its pixels replaced by indices of their colors
+struct IndexedBitmap {
+    // CV_32SC1 matrix of indices into `colors`
+    cv::Mat indices;
+    std::vector<cv::Vec3b> colors;
+};
+
+// index distinct colors of BGR bitmap in order of their appearance
+IndexedBitmap indexColors(const cv::Mat& bitmap);
+
 // convinient wrapper around cv::Mat that also provides a way of
-// accessing its parent rect, which this image was obtained from
+// accessing its parent rect, which this image was obtained from.
+// intermediate images are kept in the buffers of the image, images derived from it share the same buffers
 class Image {
 public:
     Image();
@@ -12,17 +40,21 @@ public:
     Image(const cv::Mat& mat, const cv::Rect& rect);
 
 public:
-    // takes screenshot and initialize image from it
-    static Image fromScreenshot();
+    // decodes screenshot taken with `adb::takeScreenshot()`
+    // if `buffers` is given, decodes into its screenshot buffer and the image uses them for processing
+    static Image fromScreenshot(const std::vector<uint8_t>& png, ImageBuffers* buffers = nullptr);
     // loads previously saved bitmap
     // if is_colored is false loads grayscale matrix
-    static Image fromBitmap(bool is_colored);
+    static Image fromBitmap(const std::string& path, bool is_colored);
 
-    // save pixels to bitmap
-    void saveToBitmap(int nonogram_width, int nonogram_height, bool is_colored, const std::vector<int>& margins);
+    // convert answer pixels to bitmap with one pixel per nonogram cell
+    // colors of colored answer are clustered into `color_count` colors (detected if 0),
+    // so every cell gets exactly the color of its cluster center
+    Image toBitmap(int nonogram_width, int nonogram_height, bool is_colored, const std::vector<int>& margins, int color_count = 0);
     // calculate image mask to help mask out background cells
     // if `is_inverted` is false, background colored cells are `1`
-    Image getMask(int thresh = 240, bool is_inverted = false);
+    // the mask is kept in the buffer of `slot` until the next call with the same slot
+    Image getMask(int thresh = 240, bool is_inverted = false, ImageBuffers::Mask slot = ImageBuffers::Mask::kDefault);
     // reduce noise on current mask
     Image reduceNoise();
 
@@ -40,10 +72,23 @@ public:
     // retrieve the palette of the nonogram
     // and put all the colors in corresponding order inside the vector
     Image extractPalette(std::vector<cv::Vec3b>& palette_colors, std::vector<cv::Point>& color_coords, cv::Rect nonogram_rect);
+    // refine the position of the grid on the screen after it was zoomed or dragged by aligning it to the grid lines
+    // `origin` (top-left corner of the grid) and `cell_size` are the predicted values and get updated in place.
+    // the prediction is expected to be off by less than half of a cell. Only lines inside `area` are considered
+    void refineGrid(cv::Point2d& origin, cv::Size2d& cell_size, cv::Rect area);
+
+    // buffers used for processing, `ImageBuffers::forThread()` if the image has no buffers of its own
+    ImageBuffers& buffers() const;
+
+private:
+    // image obtained from this one that shares its buffers
+    Image derive(const cv::Mat& mat, const cv::Rect& rect = {}) const;
 
 public:
     // opencv matrix
     cv::Mat mat_;
     // if not empty, matches the rect of another image that contains this image
     cv::Rect rect_;
+    // if null, `ImageBuffers::forThread()` is used
+    ImageBuffers* buffers_ = nullptr;
 };
@@ -0,0 +1,60 @@
+#include "image_buffers.h"
+
+#include <opencv2/imgproc.hpp>
+
+cv::UMatData* ImageBuffers::CountingAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                                                        cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const {
+    count_++;
+    // the default allocator becomes the owner of the data, so it's deallocated without this allocator
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage_flags);
+}
+
+bool ImageBuffers::CountingAllocator::allocate(cv::UMatData* data, cv::AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const {
+    return cv::Mat::getStdAllocator()->allocate(data, access_flags, usage_flags);
+}
+
+void ImageBuffers::CountingAllocator::deallocate(cv::UMatData* data) const {
+    cv::Mat::getStdAllocator()->deallocate(data);
+}
+
+ImageBuffers::ImageBuffers() {
+    for (auto* mats : {&grays_, &masks_}) {
+        for (cv::Mat& mat : *mats) {
+            mat.allocator = &allocator_;
+        }
+    }
+    for (cv::Mat& mat : buffers_) {
+        mat.allocator = &allocator_;
+    }
+}
+
+ImageBuffers& ImageBuffers::forThread() {
+    thread_local ImageBuffers buffers;
+    return buffers;
+}
+
+cv::Mat& ImageBuffers::gray(Mask mask) {
+    return grays_[(size_t)mask];
+}
+
+cv::Mat& ImageBuffers::mask(Mask mask) {
+    return masks_[(size_t)mask];
+}
+
+cv::Mat& ImageBuffers::buffer(Buffer buffer) {
+    return buffers_[(size_t)buffer];
+}
+
+const cv::Mat& ImageBuffers::structuringElement(int shape, cv::Size size) {
+    // elements are never removed, so the reference stays valid after unlocking
+    std::lock_guard lock(elements_mutex_);
+    auto [it, is_inserted] = elements_.try_emplace({shape, size.width, size.height});
+    if (is_inserted) {
+        it->second = cv::getStructuringElement(shape, size);
+    }
+    return it->second;
+}
+
+int ImageBuffers::allocationCount() const {
+    return allocator_.count_;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <tuple>
+
+// working buffers of the image processing that are reused between frames
+// every buffer keeps its memory, so processing frames of the same resolution allocates nothing after the first one.
+// different buffers may be used from different threads at the same time
+class ImageBuffers {
+public:
+    // call sites of `Image::getMask()`, each one has its own buffers since the images differ in size
+    enum class Mask { kDefault, kAnswer, kBitmap, kNonogram, kCanvas, kGrid, kPalette, kRefine, kCount };
+    // other intermediate images
+    enum class Buffer { kScreenshot, kNonogramLines, kPaletteInverted, kPaletteLines, kPaletteVertical, kPaletteVerticalInverted, kDebug, kCount };
+
+    ImageBuffers();
+    // disabled copy and move operations, buffers refer to the allocator of the pool
+    ImageBuffers(const ImageBuffers&) = delete;
+    ImageBuffers& operator=(const ImageBuffers&) = delete;
+    ImageBuffers(ImageBuffers&&) = delete;
+    ImageBuffers& operator=(ImageBuffers&&) = delete;
+
+public:
+    // pool of the images that don't have their own, one per thread
+    static ImageBuffers& forThread();
+
+    // grayscale image the mask is made from
+    cv::Mat& gray(Mask mask);
+    cv::Mat& mask(Mask mask);
+    cv::Mat& buffer(Buffer buffer);
+    // structuring element for morphological operations, created on the first request
+    const cv::Mat& structuringElement(int shape, cv::Size size);
+
+    // number of times the buffers had to allocate memory
+    int allocationCount() const;
+
+private:
+    // forwards to the default allocator and counts allocations
+    class CountingAllocator : public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                               cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override;
+        bool allocate(cv::UMatData* data, cv::AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const override;
+        void deallocate(cv::UMatData* data) const override;
+
+        mutable std::atomic<int> count_ = 0;
+    };
+
+private:
+    // must outlive the buffers
+    CountingAllocator allocator_;
+    std::array<cv::Mat, (size_t)Mask::kCount> grays_;
+    std::array<cv::Mat, (size_t)Mask::kCount> masks_;
+    std::array<cv::Mat, (size_t)Buffer::kCount> buffers_;
+    // (shape, width, height) -> element
+    std::map<std::tuple<int, int, int>, cv::Mat> elements_;
+    std::mutex elements_mutex_;
+};
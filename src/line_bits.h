@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+
+#include "line_solver.h"
+
+// fixed size bitset made of 64-bit words
+// all the operations are plain loops over the words, so the compiler unrolls and vectorizes them
+template <int kWords>
+struct LineBits {
+    std::array<std::uint64_t, kWords> words{};
+
+    static LineBits bit(int i) {
+        LineBits bits;
+        bits.set(i);
+        return bits;
+    }
+
+    bool test(int i) const { return (words[i / 64] >> (i % 64)) & 1; }
+    void set(int i) { words[i / 64] |= std::uint64_t(1) << (i % 64); }
+
+    LineBits& operator&=(const LineBits& other) {
+        for (int i = 0; i < kWords; i++) words[i] &= other.words[i];
+        return *this;
+    }
+    LineBits& operator|=(const LineBits& other) {
+        for (int i = 0; i < kWords; i++) words[i] |= other.words[i];
+        return *this;
+    }
+    LineBits operator&(const LineBits& other) const { return LineBits(*this) &= other; }
+    LineBits operator|(const LineBits& other) const { return LineBits(*this) |= other; }
+
+    // shift towards higher bits
+    LineBits operator<<(int shift) const {
+        LineBits result;
+        const int word_shift = shift / 64;
+        const int bit_shift = shift % 64;
+        for (int i = kWords - 1; i >= word_shift; i--) {
+            result.words[i] = words[i - word_shift] << bit_shift;
+            if (bit_shift && i - word_shift - 1 >= 0) {
+                result.words[i] |= words[i - word_shift - 1] >> (64 - bit_shift);
+            }
+        }
+        return result;
+    }
+    // shift towards lower bits
+    LineBits operator>>(int shift) const {
+        LineBits result;
+        const int word_shift = shift / 64;
+        const int bit_shift = shift % 64;
+        for (int i = 0; i + word_shift < kWords; i++) {
+            result.words[i] = words[i + word_shift] >> bit_shift;
+            if (bit_shift && i + word_shift + 1 < kWords) {
+                result.words[i] |= words[i + word_shift + 1] << (64 - bit_shift);
+            }
+        }
+        return result;
+    }
+};
+
+/*
+ * Bit-parallel version of `solveLineGeneric()` for clues with blocks of a single color.
+ * Bit p of the sets stands for the cell p or for the position p between cells (from 0 to n),
+ * so the line must be shorter than 64 * kWords cells.
+ * Every set of positions is computed for all positions at once with shifts:
+ * - free[j]: first j blocks are placed before p and p is not right after a block
+ * - ends[j]: block j can end at p (i.e. block j + 1 ends at p in `solveLineGeneric()` terms)
+ * - bfree[j]: blocks from j can be placed starting from p or later, with empty cells before them
+ * Moving through the runs of empty cells and checking runs of filled cells is done by doubling the distance,
+ * which takes O(log n) word operations instead of a loop over cells.
+ */
+template <int kWords>
+bool solveLineBits(const Clue& clue, std::span<Cell> line) {
+    using Bits = LineBits<kWords>;
+    // enough for the shortest possible blocks separated by single cells
+    constexpr int kMaxBlocks = 64 * kWords / 2 + 1;
+    constexpr int kMaxLevels = std::bit_width(unsigned(64 * kWords));
+    const int n = line.size();
+    const int k = clue.size();
+    const int levels = std::bit_width(unsigned(n));
+    const Cell fill_bit = Cell(1) << (k ? clue[0].color : 1);
+    // the clue must fit the line, this also bounds the number and the lengths of the blocks
+    int min_length = k - 1;
+    for (const Block& block : clue) {
+        min_length += block.length;
+    }
+    if (min_length > n)
+        return false;
+
+    Bits can_empty;
+    Bits can_fill;
+    for (int i = 0; i < n; i++) {
+        if (line[i] & 1) can_empty.set(i);
+        if (line[i] & fill_bit) can_fill.set(i);
+    }
+    // empty_runs[l] (fill_runs[l]): cells from p to p + 2^l - 1 all can be empty (filled)
+    std::array<Bits, kMaxLevels> empty_runs;
+    std::array<Bits, kMaxLevels> fill_runs;
+    empty_runs[0] = can_empty;
+    fill_runs[0] = can_fill;
+    for (int l = 1; l < levels; l++) {
+        empty_runs[l] = empty_runs[l - 1] & (empty_runs[l - 1] >> (1 << (l - 1)));
+        fill_runs[l] = fill_runs[l - 1] & (fill_runs[l - 1] >> (1 << (l - 1)));
+    }
+    // positions reachable from the seeds by moving right (left) over the cells that can be empty
+    auto reachRight = [&](Bits seeds) {
+        for (int l = 0; l < levels; l++) seeds |= (seeds & empty_runs[l]) << (1 << l);
+        return seeds;
+    };
+    auto reachLeft = [&](Bits seeds) {
+        for (int l = 0; l < levels; l++) seeds |= (seeds >> (1 << l)) & empty_runs[l];
+        return seeds;
+    };
+    // starts of the block of `length` cells that can be filled
+    auto fits = [&](int length) {
+        Bits result = can_fill;
+        int offset = 0;
+        for (int l = 0; l < levels; l++) {
+            if (length & (1 << l)) {
+                result &= fill_runs[l] >> offset;
+                offset += 1 << l;
+            }
+        }
+        return result;
+    };
+    // cells covered by the blocks of `length` cells starting at `starts`
+    auto cover = [&](Bits starts, int length) {
+        int covered = 1;
+        while (covered * 2 <= length) {
+            starts |= starts << covered;
+            covered *= 2;
+        }
+        if (covered < length) {
+            starts |= starts << (length - covered);
+        }
+        return starts;
+    };
+
+    std::array<Bits, kMaxBlocks> block_fits;
+    std::array<Bits, kMaxBlocks + 1> free;
+    std::array<Bits, kMaxBlocks> ends;
+    std::array<Bits, kMaxBlocks + 1> bfree;
+    std::array<Bits, kMaxBlocks> bstarts;
+
+    // forward pass
+    free[0] = reachRight(Bits::bit(0));
+    for (int j = 0; j < k; j++) {
+        block_fits[j] = fits(clue[j].length);
+        ends[j] = (free[j] & block_fits[j]) << clue[j].length;
+        // the next block needs an empty cell after the end of this one
+        free[j + 1] = reachRight((ends[j] & can_empty) << 1);
+    }
+    if (!free[k].test(n) && !(k > 0 && ends[k - 1].test(n)))
+        return false;
+
+    // backward pass
+    bfree[k] = reachLeft(Bits::bit(n));
+    for (int j = k - 1; j >= 0; j--) {
+        // positions where the block can end: right before an empty cell followed by the next blocks, or at the end
+        Bits after = (bfree[j + 1] >> 1) & can_empty;
+        if (j == k - 1) {
+            after.set(n);
+        }
+        bstarts[j] = block_fits[j] & (after >> clue[j].length);
+        bfree[j] = reachLeft(bstarts[j]);
+    }
+
+    // collect possible cell states
+    Bits filled;
+    Bits empty;
+    for (int j = 0; j < k; j++) {
+        filled |= cover(free[j] & bstarts[j], clue[j].length);
+    }
+    for (int j = 0; j <= k; j++) {
+        Bits prefix = free[j];
+        if (j > 0) {
+            prefix |= ends[j - 1];
+        }
+        empty |= prefix & (bfree[j] >> 1);
+    }
+    empty &= can_empty;
+
+    for (int i = 0; i < n; i++) {
+        line[i] &= (empty.test(i) ? 1 : 0) | (filled.test(i) ? fill_bit : 0);
+        if (!line[i])
+            return false;
+    }
+    return true;
+}
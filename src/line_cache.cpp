@@ -0,0 +1,131 @@
+#include "line_cache.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+    // splitmix64 finalizer
+    std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111eb;
+        x ^= x >> 31;
+        return x;
+    }
+
+    std::uint64_t hashKey(std::span<const std::uint64_t> key) {
+        std::uint64_t hash = key.size();
+        for (std::uint64_t word : key) {
+            hash = mix(hash ^ word);
+        }
+        return hash;
+    }
+}
+
+double LineCache::Stats::hitRate() const {
+    const std::uint64_t total = hit_count + miss_count;
+    return (total ? (double)hit_count / total : 0.0);
+}
+
+LineCache::LineCache(size_t capacity, size_t stripe_count) {
+    stripe_count = std::max<size_t>(stripe_count, 1);
+    set_count_ = std::max<size_t>(capacity / (stripe_count * kWays), 1);
+    for (size_t i = 0; i < stripe_count; i++) {
+        auto stripe = std::make_unique<Stripe>();
+        stripe->entries.resize(set_count_ * kWays);
+        stripes_.push_back(std::move(stripe));
+    }
+}
+
+void LineCache::makeKey(const Clue& clue, std::span<const Cell> line, Key& key) {
+    key.clear();
+    // header: line length and number of blocks
+    key.push_back((std::uint64_t)line.size() << 32 | clue.size());
+    // blocks, two per word
+    for (size_t i = 0; i < clue.size(); i += 2) {
+        std::uint64_t word = (std::uint64_t)clue[i].length << 8 | clue[i].color;
+        if (i + 1 < clue.size()) {
+            word |= ((std::uint64_t)clue[i + 1].length << 8 | clue[i + 1].color) << 32;
+        }
+        key.push_back(word);
+    }
+    // cells take as many bits as the widest of them, e.g. 2 bits for black & white lines
+    Cell all_bits = 0;
+    for (Cell cell : line) {
+        all_bits |= cell;
+    }
+    const int cell_bits = std::max(1, (int)std::bit_width(all_bits));
+    key.push_back(cell_bits);
+    std::uint64_t word = 0;
+    int used_bits = 0;
+    for (Cell cell : line) {
+        if (used_bits + cell_bits > 64) {
+            key.push_back(word);
+            word = 0;
+            used_bits = 0;
+        }
+        word |= (std::uint64_t)cell << used_bits;
+        used_bits += cell_bits;
+    }
+    key.push_back(word);
+}
+
+bool LineCache::solveLine(const Clue& clue, std::span<Cell> line) {
+    // bit kernels are faster than making the key
+    if (hasBitKernel(clue, line.size())) {
+        return ::solveLine(clue, line);
+    }
+    thread_local Key key;
+    makeKey(clue, line, key);
+    const std::uint64_t hash = hashKey(key);
+    Stripe& stripe = *stripes_[hash % stripes_.size()];
+    const size_t set_begin = (hash / stripes_.size()) % set_count_ * kWays;
+
+    // lookup
+    {
+        std::lock_guard lock(stripe.mutex);
+        for (size_t i = set_begin; i < set_begin + kWays; i++) {
+            Entry& entry = stripe.entries[i];
+            if (entry.key == key) {
+                entry.last_used = ++stripe.tick;
+                stripe.stats.hit_count++;
+                std::ranges::copy(entry.solved, line.begin());
+                return entry.is_solvable;
+            }
+        }
+        stripe.stats.miss_count++;
+    }
+
+    // the kernel runs without the lock
+    const bool is_solvable = ::solveLine(clue, line);
+
+    // insert in place of the least recently used entry of the set
+    // unless other thread has inserted the same line meanwhile, then it's just refreshed
+    std::lock_guard lock(stripe.mutex);
+    auto set = std::span(stripe.entries).subspan(set_begin, kWays);
+    auto it = std::ranges::find(set, key, &Entry::key);
+    if (it == set.end()) {
+        it = std::ranges::min_element(set, {}, &Entry::last_used);
+        if (!it->key.empty()) {
+            stripe.stats.eviction_count++;
+        }
+    }
+    Entry& entry = *it;
+    entry.key.assign(key.begin(), key.end());
+    entry.solved.assign(line.begin(), line.end());
+    entry.is_solvable = is_solvable;
+    entry.last_used = ++stripe.tick;
+    return is_solvable;
+}
+
+LineCache::Stats LineCache::stats() const {
+    Stats total;
+    for (const auto& stripe : stripes_) {
+        std::lock_guard lock(stripe->mutex);
+        total.hit_count += stripe->stats.hit_count;
+        total.miss_count += stripe->stats.miss_count;
+        total.eviction_count += stripe->stats.eviction_count;
+    }
+    return total;
+}
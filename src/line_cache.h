@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "line_solver.h"
+
+// fixed capacity cache of line solving results that can be shared between threads
+// the key is the clue together with the line state before solving, the value is the deduced line
+// the table is split into stripes with their own locks, every stripe is a set-associative table
+// where the least recently used entry of the set is evicted
+class LineCache {
+public:
+    struct Stats {
+        std::uint64_t hit_count = 0;
+        std::uint64_t miss_count = 0;
+        std::uint64_t eviction_count = 0;
+
+        double hitRate() const;
+    };
+
+    // capacity is the number of cached lines
+    explicit LineCache(size_t capacity, size_t stripe_count = 64);
+    // disabled copy and move operations
+    LineCache(const LineCache&) = delete;
+    LineCache& operator=(const LineCache&) = delete;
+    LineCache(LineCache&&) = delete;
+    LineCache& operator=(LineCache&&) = delete;
+
+public:
+    // same as `::solveLine()`, but the line kernel is skipped if the result is cached
+    // only lines solved by `solveLineGeneric()` go through the cache and count in the stats
+    bool solveLine(const Clue& clue, std::span<Cell> line);
+
+    // counters summed over all stripes
+    Stats stats() const;
+
+private:
+    using Key = std::vector<std::uint64_t>;
+
+    struct Entry {
+        Key key;
+        std::vector<Cell> solved;
+        bool is_solvable = false;
+        std::uint64_t last_used = 0;
+    };
+
+    struct Stripe {
+        mutable std::mutex mutex;
+        std::vector<Entry> entries;
+        // logical clock for LRU
+        std::uint64_t tick = 0;
+        Stats stats;
+    };
+
+    // pack the clue and the line into words
+    static void makeKey(const Clue& clue, std::span<const Cell> line, Key& key);
+
+private:
+    static constexpr size_t kWays = 4;
+
+    size_t set_count_;
+    std::vector<std::unique_ptr<Stripe>> stripes_;
+};
@@ -0,0 +1,133 @@
+#include "line_solver.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "line_bits.h"
+
+bool hasBitKernel(const Clue& clue, size_t length) {
+    // blocks of a single color don't need to track colors and are solved bit-parallel,
+    // positions between cells take one bit more than the cells
+    const bool is_single_colored = std::ranges::all_of(clue, [&](const Block& block) { return block.color == clue[0].color; });
+    return is_single_colored && length < 256;
+}
+
+bool solveLine(const Clue& clue, std::span<Cell> line) {
+    if (hasBitKernel(clue, line.size())) {
+        if (line.size() < 64)
+            return solveLineBits<1>(clue, line);
+        if (line.size() < 128)
+            return solveLineBits<2>(clue, line);
+        return solveLineBits<4>(clue, line);
+    }
+    return solveLineGeneric(clue, line);
+}
+
+/*
+ * The line is solved with dynamic programming over (number of blocks, number of cells).
+ * Forward pass finds all the ways to place first blocks into the beginning of the line,
+ * backward pass finds all the ways to place last blocks into the end of the line.
+ * A cell can take a color if some block of that color fits over it with valid prefix and suffix,
+ * and it can stay empty if the line can be split into valid prefix and suffix right at the cell.
+ * Adjacent blocks of the same color need at least one empty cell between them,
+ * blocks of different colors may touch.
+ */
+bool solveLineGeneric(const Clue& clue, std::span<Cell> line) {
+    const int n = line.size();
+    const int k = clue.size();
+    const int stride = n + 2;
+    auto at = [&](std::vector<char>& v, int j, int i) -> char& { return v[j * stride + i]; };
+    auto canEmpty = [&](int i) { return (line[i] & 1) != 0; };
+
+    // prefix counts of cells that can't take the color of the block
+    // so that fitting the block is checked in O(1)
+    std::vector<int> blocked((k + 1) * stride, 0);
+    for (int j = 0; j < k; j++) {
+        const Cell color_bit = Cell(1) << clue[j].color;
+        for (int i = 0; i < n; i++) {
+            blocked[j * stride + i + 1] = blocked[j * stride + i] + ((line[i] & color_bit) ? 0 : 1);
+        }
+    }
+    auto fits = [&](int j, int start, int end) {
+        return start >= 0 && end <= n && blocked[j * stride + end] == blocked[j * stride + start];
+    };
+    // same colored blocks must be separated
+    auto canTouch = [&](int j1, int j2) { return clue[j1].color != clue[j2].color; };
+
+    // E(j, i): first j blocks are placed in [0, i) and cell i - 1 is empty (or there are no cells)
+    // B(j, i): first j blocks are placed in [0, i) and block j - 1 ends exactly at i
+    std::vector<char> fwd_empty((k + 1) * stride, 0);
+    std::vector<char> fwd_block((k + 1) * stride, 0);
+    at(fwd_empty, 0, 0) = 1;
+    for (int i = 1; i <= n; i++) {
+        for (int j = 0; j <= k; j++) {
+            at(fwd_empty, j, i) = canEmpty(i - 1) && (at(fwd_empty, j, i - 1) || at(fwd_block, j, i - 1));
+            if (j > 0) {
+                const int start = i - clue[j - 1].length;
+                at(fwd_block, j, i) = fits(j - 1, start, i) &&
+                    (at(fwd_empty, j - 1, start) || (j > 1 && at(fwd_block, j - 1, start) && canTouch(j - 2, j - 1)));
+            }
+        }
+    }
+    if (!at(fwd_empty, k, n) && !at(fwd_block, k, n))
+        return false;
+
+    // E'(j, i): blocks from j are placed in [i, n) and cell i is empty (or there are no cells)
+    // B'(j, i): blocks from j are placed in [i, n) and block j starts exactly at i
+    std::vector<char> bwd_empty((k + 1) * stride, 0);
+    std::vector<char> bwd_block((k + 1) * stride, 0);
+    at(bwd_empty, k, n) = 1;
+    for (int i = n - 1; i >= 0; i--) {
+        for (int j = k; j >= 0; j--) {
+            at(bwd_empty, j, i) = canEmpty(i) && (at(bwd_empty, j, i + 1) || at(bwd_block, j, i + 1));
+            if (j < k) {
+                const int end = i + clue[j].length;
+                at(bwd_block, j, i) = fits(j, i, end) &&
+                    (at(bwd_empty, j + 1, end) || (j + 1 < k && at(bwd_block, j + 1, end) && canTouch(j, j + 1)));
+            }
+        }
+    }
+
+    // collect possible colors of every cell
+    // blocks mark their cells with difference arrays to not iterate over every cell of every placement
+    std::vector<Cell> possible(n, 0);
+    std::vector<int> covered((k + 1) * stride, 0);
+    for (int j = 0; j < k; j++) {
+        const int length = clue[j].length;
+        for (int start = 0; start + length <= n; start++) {
+            const int end = start + length;
+            const bool is_prefix_valid = at(fwd_empty, j, start) || (j > 0 && at(fwd_block, j, start) && canTouch(j - 1, j));
+            const bool is_suffix_valid = at(bwd_empty, j + 1, end) || (j + 1 < k && at(bwd_block, j + 1, end) && canTouch(j, j + 1));
+            if (fits(j, start, end) && is_prefix_valid && is_suffix_valid) {
+                covered[j * stride + start]++;
+                covered[j * stride + end]--;
+            }
+        }
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            count += covered[j * stride + i];
+            if (count > 0) {
+                possible[i] |= Cell(1) << clue[j].color;
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (!canEmpty(i))
+            continue;
+        for (int j = 0; j <= k; j++) {
+            const bool is_prefix_valid = at(fwd_empty, j, i) || at(fwd_block, j, i);
+            const bool is_suffix_valid = at(bwd_empty, j, i + 1) || at(bwd_block, j, i + 1);
+            if (is_prefix_valid && is_suffix_valid) {
+                possible[i] |= 1;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        line[i] &= possible[i];
+        if (!line[i])
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "nonogram.h"
+
+// cell state is the bitmask of colors the cell still can take, bit 0 stands for the background
+using Cell = std::uint32_t;
+
+// deduce everything possible about the line from its clue and current state
+// cells are narrowed in place. Returns false if the line contradicts the clue
+// picks the fastest kernel for the clue and the line length
+bool solveLine(const Clue& clue, std::span<Cell> line);
+// true if `solveLine()` picks a bit-parallel kernel for the clue and the line length
+// such lines are about as cheap to solve as to look up in a cache
+bool hasBitKernel(const Clue& clue, size_t length);
+
+// straightforward kernel that works for any clue and line length
+bool solveLineGeneric(const Clue& clue, std::span<Cell> line);
@@ -1,8 +1,17 @@
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <cxxopts.hpp>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "batch.h"
 #include "controls.h"
+#include "device_pool.h"
+#include "nonogram.h"
 #include "screen.h"
 
 /* *
@@ -20,10 +29,20 @@ int main(int argc, char* argv[]) {
         // mode
         ("c,capture", "Capture mode", cxxopts::value<bool>())
         ("p,paint", "Paint mode", cxxopts::value<bool>())
+        ("s,solve", "Solve mode: solve the nonogram from the file in .non format and paint it while solving", cxxopts::value<std::string>())
+        ("d,devices", "Run on all connected devices at once", cxxopts::value<bool>())
+        ("b,batch", "Batch mode: solve nonogram files or directories of them without the device (repeat or separate with commas)", cxxopts::value<std::vector<std::string>>())
+        // batch options
+        ("j,jobs", "Number of threads in batch mode (0 for all cores)", cxxopts::value<unsigned>()->default_value("0"))
+        ("output", "Output file of batch mode (default stdout)", cxxopts::value<std::string>())
+        ("cache", "Number of line solving results cached in batch mode, e.g. 65536 (0 to disable)", cxxopts::value<size_t>()->default_value("0"))
         // colored flag
         ("o,colored", "Colored nonogram (default black and white)", cxxopts::value<bool>())
+        ("k,colors", "Number of distinct colors of the colored answer including background (0 to detect)", cxxopts::value<int>()->default_value("0"))
         // margins
         ("m,margins", "Margins in the format: left,top,right,bottom", cxxopts::value<std::vector<int>>()->default_value("0,0,0,0"))
+        // zooming
+        ("z,min-cell", "Minimal cell size in pixels to paint at default zoom, smaller cells are painted zoomed in tile by tile (0 to disable)", cxxopts::value<int>()->default_value("0"))
     ;
 
     options.parse_positional({"width", "height"});
@@ -35,28 +54,80 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    // mode
-    bool is_capture_mode = args["capture"].as<bool>();
-    bool is_paint_mode = args["paint"].as<bool>();
-
-    if (!is_capture_mode && !is_paint_mode) {
-        std::cout << "No mode options were specified. Going with multimode." << std::endl;
-        is_capture_mode = true;
-        is_paint_mode = true;
+    // batch mode works offline
+    if (args.count("batch")) {
+        std::ofstream file;
+        if (args.count("output")) {
+            file.open(args["output"].as<std::string>());
+            if (!file.is_open()) {
+                std::cout << "Error: unable to open output file." << std::endl;
+                return 1;
+            }
+        }
+        std::ostream& out = (file.is_open() ? file : std::cout);
+        BatchSummary summary = solveBatch(args["batch"].as<std::vector<std::string>>(), args["jobs"].as<unsigned>(), args["cache"].as<size_t>(), out);
+        // summary goes to stderr to keep answers in stdout clean
+        const int total_count = summary.solved_count + summary.failed_count;
+        std::cerr << std::format("solved {} of {} puzzles in {:.2f}s ({:.1f} puzzles/s, line cache hit rate {:.1f}%)",
+                                 summary.solved_count, total_count, summary.seconds, total_count / std::max(summary.seconds, 1e-9),
+                                 summary.cache_hit_rate * 100) << std::endl;
+        return (summary.failed_count ? 1 : 0);
     }
 
-    bool is_multimode = (is_capture_mode && is_paint_mode);
+    // the job that is done on every device
+    std::function<void(Screen&)> job;
+    if (args.count("solve")) {
+        // solve mode doesn't need anything else
+        Nonogram nonogram;
+        try {
+            nonogram = Nonogram::fromFile(args["solve"].as<std::string>());
+        } catch (const std::runtime_error& error) {
+            std::cout << error.what() << std::endl;
+            return 1;
+        }
+        job = [nonogram = std::move(nonogram)](Screen& screen) {
+            screen.solveAndPaint(nonogram);
+        };
+    } else {
+        // mode
+        bool is_capture_mode = args["capture"].as<bool>();
+        bool is_paint_mode = args["paint"].as<bool>();
 
-    // width and height
-    int nonogram_width = args["width"].as<int>();
-    int nonogram_height = args["height"].as<int>();
-    // colored
-    bool is_colored = args["colored"].as<bool>();
-    // margins
-    std::vector<int> margins = args["margins"].as<std::vector<int>>();
-    if (margins.size() != 4) {
-        std::cout << "Error: margins are in invalid format. Should be `left,top,right,bottom`" << std::endl;
-        return 1;
+        if (!is_capture_mode && !is_paint_mode) {
+            std::cout << "No mode options were specified. Going with multimode." << std::endl;
+            is_capture_mode = true;
+            is_paint_mode = true;
+        }
+
+        bool is_multimode = (is_capture_mode && is_paint_mode);
+
+        // width and height
+        int nonogram_width = args["width"].as<int>();
+        int nonogram_height = args["height"].as<int>();
+        // colored
+        bool is_colored = args["colored"].as<bool>();
+        int color_count = args["colors"].as<int>();
+        // margins
+        std::vector<int> margins = args["margins"].as<std::vector<int>>();
+        if (margins.size() != 4) {
+            std::cout << "Error: margins are in invalid format. Should be `left,top,right,bottom`" << std::endl;
+            return 1;
+        }
+        // minimal cell size
+        int min_cell_size = args["min-cell"].as<int>();
+
+        job = [=](Screen& screen) {
+            // connect to the device for painting while the answer is captured
+            if (is_paint_mode) {
+                screen.prepareSession();
+            }
+            if (is_capture_mode) {
+                screen.captureAnswer(nonogram_width, nonogram_height, is_colored, margins, color_count);
+            }
+            if (is_paint_mode) {
+                screen.paint(nonogram_width, nonogram_height, is_colored, is_multimode, min_cell_size);
+            }
+        };
     }
 
     // check if device is connected
@@ -66,13 +137,11 @@ int main(int argc, char* argv[]) {
     }
 
     // run
-    Screen screen;
-    if (is_capture_mode) {
-        screen.captureAnswer(nonogram_width, nonogram_height, is_colored, margins);
-    }
-    if (is_paint_mode) {
-        screen.paint(nonogram_width, nonogram_height, is_colored, is_multimode);
+    if (args["devices"].as<bool>()) {
+        return (runDevicePool(job) ? 1 : 0);
     }
+    Screen screen;
+    job(screen);
 
     return 0;
 }
@@ -0,0 +1,167 @@
+#include "nonogram.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    // parse clue line like `1,2,3` or `2a 1b`. Empty line or `0` is an empty clue
+    Clue parseClue(const std::string& line) {
+        Clue clue;
+        size_t pos = 0;
+        while (pos < line.size()) {
+            if (!std::isdigit((unsigned char)line[pos])) {
+                pos++;
+                continue;
+            }
+            Block block;
+            while (pos < line.size() && std::isdigit((unsigned char)line[pos])) {
+                block.length = block.length * 10 + (line[pos++] - '0');
+            }
+            if (pos < line.size() && std::islower((unsigned char)line[pos])) {
+                block.color = line[pos++] - 'a' + 1;
+            }
+            if (block.length > 0) {
+                clue.push_back(block);
+            }
+        }
+        return clue;
+    }
+
+    // read `count` clue lines following the section keyword
+    std::vector<Clue> parseClues(std::ifstream& file, int count) {
+        std::vector<Clue> clues;
+        std::string line;
+        while ((int)clues.size() < count && std::getline(file, line)) {
+            clues.push_back(parseClue(line));
+        }
+        if ((int)clues.size() != count) {
+            throw std::runtime_error("error: unexpected end of nonogram file");
+        }
+        return clues;
+    }
+}
+
+namespace {
+    Nonogram parseNon(std::ifstream& file) {
+        Nonogram nonogram;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::string key = line.substr(0, line.find_first_of(" \t\r"));
+            if (key == "width") {
+                nonogram.width = std::stoi(line.substr(key.size()));
+            } else if (key == "height") {
+                nonogram.height = std::stoi(line.substr(key.size()));
+            } else if (key == "rows") {
+                nonogram.rows = parseClues(file, nonogram.height);
+            } else if (key == "columns") {
+                nonogram.cols = parseClues(file, nonogram.width);
+            }
+            // other keys (title, author, goal, etc.) are ignored
+        }
+        return nonogram;
+    }
+
+    Nonogram parseCwd(std::ifstream& file) {
+        Nonogram nonogram;
+        if (!(file >> nonogram.height >> nonogram.width)) {
+            throw std::runtime_error("error: missing nonogram sizes");
+        }
+        // skip the rest of the line with the width
+        std::string line;
+        std::getline(file, line);
+        nonogram.rows = parseClues(file, nonogram.height);
+        // rows and columns may be separated by an empty line
+        while (file.peek() == '\n' || file.peek() == '\r') {
+            file.get();
+        }
+        nonogram.cols = parseClues(file, nonogram.width);
+        return nonogram;
+    }
+}
+
+Nonogram Nonogram::fromFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("error: unable to open nonogram file " + path);
+    }
+    const bool is_cwd = path.ends_with(".cwd");
+    Nonogram nonogram = (is_cwd ? parseCwd(file) : parseNon(file));
+    if (nonogram.width <= 0 || nonogram.height <= 0 || (int)nonogram.rows.size() != nonogram.height || (int)nonogram.cols.size() != nonogram.width) {
+        throw std::runtime_error("error: invalid nonogram file " + path);
+    }
+    // count colors
+    for (const std::vector<Clue>* clues : {&nonogram.rows, &nonogram.cols}) {
+        for (const Clue& clue : *clues) {
+            for (const Block& block : clue) {
+                nonogram.color_count = std::max(nonogram.color_count, block.color);
+            }
+        }
+    }
+    return nonogram;
+}
+
+namespace {
+    void writeClues(std::ofstream& file, const std::vector<Clue>& clues, bool is_colored) {
+        for (const Clue& clue : clues) {
+            if (clue.empty()) {
+                file << 0;
+            }
+            for (size_t i = 0; i < clue.size(); i++) {
+                file << (i ? "," : "") << clue[i].length;
+                if (is_colored) {
+                    file << (char)('a' + clue[i].color - 1);
+                }
+            }
+            file << '\n';
+        }
+    }
+}
+
+void Nonogram::saveToFile(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("error: unable to write nonogram file " + path);
+    }
+    const bool is_colored = color_count > 1;
+    file << "width " << width << '\n';
+    file << "height " << height << '\n';
+    file << "rows\n";
+    writeClues(file, rows, is_colored);
+    file << "columns\n";
+    writeClues(file, cols, is_colored);
+}
+
+namespace {
+    // collect blocks of the line, `at(i)` returns color of the cell i
+    template <typename At>
+    Clue makeClue(int length, At at) {
+        Clue clue;
+        for (int i = 0; i < length; i++) {
+            const int color = at(i);
+            if (color == 0)
+                continue;
+            if (i > 0 && at(i - 1) == color) {
+                clue.back().length++;
+            } else {
+                clue.push_back({1, color});
+            }
+        }
+        return clue;
+    }
+}
+
+Nonogram Nonogram::fromSolution(int width, int height, int color_count, const std::vector<int>& colors) {
+    Nonogram nonogram;
+    nonogram.width = width;
+    nonogram.height = height;
+    nonogram.color_count = color_count;
+    for (int row = 0; row < height; row++) {
+        nonogram.rows.push_back(makeClue(width, [&](int col) { return colors[row * width + col]; }));
+    }
+    for (int col = 0; col < width; col++) {
+        nonogram.cols.push_back(makeClue(height, [&](int row) { return colors[row * width + col]; }));
+    }
+    return nonogram;
+}
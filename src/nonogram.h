@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// a block of consecutive cells of the same color described by a clue
+struct Block {
+    int length = 0;
+    // colors are numbered from 1, 0 stands for the background
+    int color = 1;
+};
+
+// clue of a single row or column
+using Clue = std::vector<Block>;
+
+// nonogram puzzle given by its clues
+struct Nonogram {
+    int width = 0;
+    int height = 0;
+    // number of colors except the background, 1 for black and white nonograms
+    int color_count = 1;
+    std::vector<Clue> rows;
+    std::vector<Clue> cols;
+
+    // load nonogram from the file, the format is chosen by the extension:
+    // - .non: colored blocks are written with a color letter after the length (e.g. `3a,1b`), `a` being the first color
+    // - .cwd: height and width on the first two lines, then clues of rows and columns with space separated lengths
+    static Nonogram fromFile(const std::string& path);
+    // save nonogram to the file in .non format
+    void saveToFile(const std::string& path) const;
+    // make clues of the given solution
+    // `colors` are the colors of the cells in row-major order, 0 is the background
+    static Nonogram fromSolution(int width, int height, int color_count, const std::vector<int>& colors);
+};
@@ -1,25 +1,70 @@
 #include "screen.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <format>
+#include <future>
 #include <iostream>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <thread>
 
-#include "controls.h"
+#include "solver.h"
+#include "spsc_queue.h"
 
-Screen::Screen() {
+Screen::Screen(Device device) : device_(std::move(device)) {
     update();
 }
 
 void Screen::update() {
-    adb::takeScreenshot();
-    screen_image_ = Image::fromScreenshot();
+    screen_image_ = Image::fromScreenshot(adb::takeScreenshot(device_), &image_buffers_);
 }
 
-void Screen::captureAnswer(int width, int height, bool is_colored, const std::vector<int>& margins) {
-    screen_image_.extractAnswer().saveToBitmap(width, height, is_colored, margins);
+void Screen::prepareSession() {
+    if (session_.valid())
+        return;
+    session_ = std::async(std::launch::async, [width = screen_image_.mat_.cols, height = screen_image_.mat_.rows, device = device_] {
+        return std::make_unique<ControlSession>(width, height, device);
+    });
+}
+
+std::unique_ptr<ControlSession> Screen::takeSession() {
+    if (!session_.valid()) {
+        prepareSession();
+    }
+    return session_.get();
+}
+
+int Screen::tapCount() const {
+    return tap_count_;
+}
+
+int Screen::imageAllocationCount() const {
+    return image_buffers_.allocationCount();
+}
+
+std::string Screen::devicePath(const std::string& file_name) const {
+    if (device_.serial.empty())
+        return file_name;
+    // serials of network devices look like `192.168.0.2:5555`
+    std::string suffix = device_.serial;
+    std::replace_if(suffix.begin(), suffix.end(), [](char c) { return !std::isalnum((unsigned char)c); }, '_');
+    const size_t dot = file_name.rfind('.');
+    return file_name.substr(0, dot) + "_" + suffix + file_name.substr(dot);
+}
+
+void Screen::saveImageError(const ImageError& error) const {
+    cv::imwrite(devicePath(error.file_name_), error.image_);
+}
+
+void Screen::captureAnswer(int width, int height, bool is_colored, const std::vector<int>& margins, int color_count) {
+    answer_ = screen_image_.extractAnswer().toBitmap(width, height, is_colored, margins, color_count).mat_;
+    cv::imwrite(devicePath("bitmap.bmp"), answer_);
+    // keep the answer in the same format as it's loaded from the file
+    if (!is_colored) {
+        cv::cvtColor(answer_, answer_, cv::COLOR_BGR2GRAY);
+    }
 }
 
 namespace {
@@ -39,10 +84,59 @@ namespace {
     }
 }
 
-void Screen::paint(int width, int height, bool is_colored, bool is_multimode) {
+namespace {
+    // tap every cell of `tile`, color group by color group
+    // `color_coords` are the palette positions, which are empty for black & white nonograms
+    // returns number of cells that were skipped because they were out of `work_area`
+    int paintCells(ControlSession& ctrl, const Viewport& viewport, const std::vector<std::vector<cv::Point>>& color_cells,
+                   const std::vector<cv::Point>& color_coords, cv::Rect tile, cv::Rect work_area) {
+        const bool is_colored = !color_coords.empty();
+        int skipped_count = 0;
+        for (size_t i_color = 0; i_color < color_cells.size(); i_color++) {
+            std::vector<cv::Point> points;
+            for (const cv::Point& cell : color_cells[i_color]) {
+                if (!tile.contains(cell))
+                    continue;
+                cv::Point point = viewport.toScreen(cell.x, cell.y);
+                if (!work_area.contains(point)) {
+                    skipped_count++;
+                    continue;
+                }
+                points.push_back(point);
+            }
+            if (points.empty())
+                continue;
+
+            if (is_colored) {
+                ctrl.tap(color_coords[i_color].x, color_coords[i_color].y);
+                // after tapping the color the application needs some time to apply it
+                std::this_thread::sleep_for(500ms);
+            }
+            for (const cv::Point& point : points) {
+                if (is_colored) {
+                    // default touch duration of 5ms may be too fast for application to handle.
+                    // in case of black & white puzzles the image is completed after the lags are gone
+                    // but for colored nonograms the colors may not be applied correctly.
+                    // so it's better to increase touch duration and prevent app from lagging
+                    ctrl.tap(point.x, point.y, 20ms);
+                } else {
+                    ctrl.tap(point.x, point.y);
+                }
+            }
+        }
+        return skipped_count;
+    }
+}
+
+void Screen::paint(int width, int height, bool is_colored, bool is_multimode, int min_cell_size) {
+    // the work is done as a small task graph to get to the first tap sooner:
+    // the control session is connected in background while the screen is parsed,
+    // the palette is parsed at the same time as the grid, and taps are planned before waiting for the session
+    prepareSession();
+
     // if in multimode, tap to the center of the screen once to hide the answer
     if (is_multimode) {
-        adb::tap(screen_image_.mat_.cols / 2, screen_image_.mat_.rows / 2);
+        adb::tap(device_, screen_image_.mat_.cols / 2, screen_image_.mat_.rows / 2);
         // wait until fade animation finishes
         std::this_thread::sleep_for(200ms);
         // update the screen
@@ -50,81 +144,282 @@ void Screen::paint(int width, int height, bool is_colored, bool is_multimode) {
     }
 
     // parse nonogram
-    Image nonogram = screen_image_.extractNonogram();
-    cv::imwrite("nonogram.png", nonogram.mat_);
+    Image nonogram = saveErrorImage([&] { return screen_image_.extractNonogram(); });
+    // the screenshot doesn't change until painting starts, so it's saved in background
+    std::future<void> nonogram_saving = std::async(std::launch::async, [&] {
+        cv::imwrite(devicePath("nonogram.png"), nonogram.mat_);
+    });
+    // parse color palette
+    std::vector<cv::Vec3b> palette_colors;
+    std::vector<cv::Point> color_coords;
+    std::future<void> palette_parsing;
+    if (is_colored) {
+        palette_parsing = std::async(std::launch::async, [&] {
+            screen_image_.extractPalette(palette_colors, color_coords, nonogram.rect_);
+        });
+    }
     // parse grid and background color
     cv::Vec3b bg_color;
-    Image grid = nonogram.extractGrid(bg_color, width, height);
+    Image grid = saveErrorImage([&] { return nonogram.extractGrid(bg_color, width, height); });
     std::cout << std::format("background color is rgb({}, {}, {})", bg_color[2], bg_color[1], bg_color[0]) << std::endl;
-    // calculate cell sizes in pixels
-    const double cell_width = (double)grid.mat_.cols / width;
-    const double cell_height = (double)grid.mat_.rows / height;
-    // calculate x and y positions
-    const double x_start = grid.rect_.x + cell_width / 2;
-    const double y_start = grid.rect_.y + cell_height / 2;
-    double x = x_start;
-    double y = y_start;
+    // map cells to the screen at default zoom
+    Viewport viewport{
+        cv::Point2d(grid.rect_.x, grid.rect_.y),
+        cv::Size2d((double)grid.mat_.cols / width, (double)grid.mat_.rows / height)
+    };
+    auto cellRect = [&](int col, int row) {
+        cv::Rect2d rect = viewport.toScreen(cv::Rect(col, row, 1, 1));
+        return cv::Rect((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height);
+    };
+
+    if (answer_.empty()) {
+        answer_ = Image::fromBitmap(devicePath("bitmap.bmp"), is_colored).mat_;
+    }
+    const cv::Mat& answer = answer_;
+    // for debugging
+    cv::Mat& debug = image_buffers_.buffer(ImageBuffers::Buffer::kDebug);
+    screen_image_.mat_.copyTo(debug);
+    ColorCells color_cells;
     if (is_colored) {
-        cv::Mat answer = Image::fromBitmap(is_colored).mat_;
-        // for debugging
-        cv::Mat debug = screen_image_.mat_.clone();
-        // parse color palette
-        std::vector<cv::Vec3b> palette_colors;
-        std::vector<cv::Point> color_coords;
-        Image palette = screen_image_.extractPalette(palette_colors, color_coords, nonogram.rect_);
+        palette_parsing.get();
         const int color_count = palette_colors.size();
         palette_colors.push_back(bg_color);
 
         // the application behaves weirdly on rapid changing of current color,
         // so unlike black & white puzzles when nonogram is filled row by row
         // the colored nonogram will be filled by each color group
-        std::vector<std::vector<cv::Point>> color_points(color_count);
-        for (int row = 0; row < height; row++, y += cell_height) {
-            x = x_start;
-            for (int col = 0; col < width; col++, x += cell_width) {
-                cv::Vec3b answer_cell_color = answer.at<cv::Vec3b>(cv::Point(col, row));
-                int i_color = findClosestColor(palette_colors, answer_cell_color);
+        color_cells.resize(color_count);
+        // cells of the captured answer have just a few distinct colors (centers of the color clusters),
+        // so match every distinct color to the palette once instead of doing it for every cell
+        IndexedBitmap indexed_answer = indexColors(answer);
+        std::vector<int> palette_indices(indexed_answer.colors.size());
+        for (size_t i = 0; i < palette_indices.size(); i++) {
+            palette_indices[i] = findClosestColor(palette_colors, indexed_answer.colors[i]);
+        }
+        for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
+                int i_color = palette_indices[indexed_answer.indices.at<int>(cv::Point(col, row))];
                 // the last color of the vector is bg color, skip it
                 if (i_color == color_count)
                     continue;
-                // then tap the cell
-                color_points[i_color].push_back({(int)x, (int)y});
+                color_cells[i_color].push_back({col, row});
                 // for debugging
-                cv::rectangle(debug, { (int)(x - cell_width / 2), (int)(y - cell_height / 2), (int)cell_width, (int)cell_height }, palette_colors[i_color], cv::FILLED);
-            }
-        }
-        cv::imwrite("debug.png", debug);
-
-        // start painting every color group
-        ControlSession ctrl(screen_image_.mat_.cols, screen_image_.mat_.rows);
-        for (int i_color = 0; i_color < color_count; i_color++) {
-            ctrl.tap(color_coords[i_color].x, color_coords[i_color].y);
-            // after tapping the color the application needs some time to apply it
-            std::this_thread::sleep_for(500ms);
-            // tap every cell of current color
-            for (const cv::Point& point : color_points[i_color]) {
-                // default touch duration of 5ms may be too fast for application to handle.
-                // in case of black & white puzzles the image is completed after the lags are gone
-                // but for colored nonograms the colors may not be applied correctly.
-                // so it's better to increase touch duration and prevent app from lagging
-                ctrl.tap(point.x, point.y, 20ms);
+                cv::rectangle(debug, cellRect(col, row), palette_colors[i_color], cv::FILLED);
             }
         }
     } else {
-        cv::Mat answer = Image::fromBitmap(is_colored).mat_;
-        // for debugging
-        cv::Mat debug = screen_image_.mat_.clone();
-        // start painting
-        ControlSession ctrl(screen_image_.mat_.cols, screen_image_.mat_.rows);
-        for (int row = 0; row < height; row++, y += cell_height) {
-            x = x_start;
-            for (int col = 0; col < width; col++, x += cell_width) {
+        color_cells.resize(1);
+        for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
                 if (answer.at<uchar>(cv::Point(col, row)) < 230) {
-                    ctrl.tap(x, y);
-                    cv::rectangle(debug, { (int)(x - cell_width / 2), (int)(y - cell_height / 2), (int)cell_width, (int)cell_height }, cv::Scalar(0, 0, 0), cv::FILLED);
+                    color_cells[0].push_back({col, row});
+                    cv::rectangle(debug, cellRect(col, row), cv::Scalar(0, 0, 0), cv::FILLED);
                 }
             }
         }
-        cv::imwrite("debug.png", debug);
+    }
+    // the debug image isn't touched during painting
+    std::future<void> debug_saving = std::async(std::launch::async, [&] {
+        cv::imwrite(devicePath("debug.png"), debug);
+    });
+    // new screenshots taken while painting overwrite the nonogram image
+    nonogram_saving.get();
+
+    // start painting
+    std::unique_ptr<ControlSession> session = takeSession();
+    ControlSession& ctrl = *session;
+    if (std::min(viewport.cell_size.width, viewport.cell_size.height) >= min_cell_size) {
+        paintCells(ctrl, viewport, color_cells, color_coords, cv::Rect(0, 0, width, height), grid.rect_);
+    } else {
+        paintTiled(ctrl, viewport, grid.rect_, width, height, min_cell_size, color_cells, color_coords);
+    }
+    tap_count_ += ctrl.tapCount();
+}
+
+void Screen::paintTiled(ControlSession& ctrl, Viewport viewport, cv::Rect work_area, int width, int height, int min_cell_size,
+                        const ColorCells& color_cells, const std::vector<cv::Point>& color_coords) {
+    // fingers can't go beyond the screen, so zooming is done in several pinches
+    constexpr double kMaxPinchScale = 3.0;
+    constexpr int kMaxPinchCount = 5;
+    // gestures start this far from the work area borders to not touch anything around the grid
+    constexpr int kGestureMargin = 20;
+
+    // zoom in around the center of the work area
+    const cv::Point2d zoom_center(work_area.x + work_area.width / 2.0, work_area.y + work_area.height / 2.0);
+    for (int i = 0; i < kMaxPinchCount; i++) {
+        const double remaining_scale = min_cell_size / std::min(viewport.cell_size.width, viewport.cell_size.height);
+        if (remaining_scale <= 1.0)
+            break;
+        const double pinch_scale = std::min(remaining_scale, kMaxPinchScale);
+        // fingers end up apart by most of the work area width
+        const int distance = (work_area.width - 2 * kGestureMargin) / pinch_scale;
+        ctrl.pinch(zoom_center.x, zoom_center.y, distance, pinch_scale);
+        viewport.zoom(zoom_center, pinch_scale);
+        relocalize(viewport, work_area);
+    }
+
+    // split the answer into tiles that fit into the work area at the actual zoom
+    cv::Size tile_size(
+        (work_area.width - 2 * kGestureMargin) / viewport.cell_size.width,
+        (work_area.height - 2 * kGestureMargin) / viewport.cell_size.height
+    );
+    std::vector<cv::Rect> tiles;
+    for (const cv::Rect& tile : planTiles(width, height, tile_size)) {
+        // skip tiles without anything to paint, they are not worth a pan
+        bool is_empty = std::ranges::none_of(color_cells, [&](const std::vector<cv::Point>& cells) {
+            return std::ranges::any_of(cells, [&](const cv::Point& cell) { return tile.contains(cell); });
+        });
+        if (!is_empty)
+            tiles.push_back(tile);
+    }
+    std::cout << std::format("painting {} tiles of {}x{} cells", tiles.size(), tile_size.width, tile_size.height) << std::endl;
+
+    int skipped_count = 0;
+    for (const cv::Rect& tile : tiles) {
+        // place the tile in the top-left corner of the work area,
+        // but the tiles on the right and bottom edges of the nonogram are aligned to the opposite corner,
+        // because the application doesn't let the grid be dragged far beyond its edges
+        cv::Rect2d tile_rect = viewport.toScreen(tile);
+        cv::Point2d target(
+            tile.br().x == width ? work_area.br().x - kGestureMargin - tile_rect.width : work_area.x + kGestureMargin,
+            tile.br().y == height ? work_area.br().y - kGestureMargin - tile_rect.height : work_area.y + kGestureMargin
+        );
+        cv::Point2d delta = target - tile_rect.tl();
+        // single drag can't be longer than the work area
+        const cv::Point2d max_drag(work_area.width - 2 * kGestureMargin, work_area.height - 2 * kGestureMargin);
+        bool is_moved = false;
+        while (std::abs(delta.x) >= 1 || std::abs(delta.y) >= 1) {
+            cv::Point2d drag(std::clamp(delta.x, -max_drag.x, max_drag.x), std::clamp(delta.y, -max_drag.y, max_drag.y));
+            cv::Point2d start(
+                drag.x > 0 ? work_area.x + kGestureMargin : work_area.br().x - kGestureMargin,
+                drag.y > 0 ? work_area.y + kGestureMargin : work_area.br().y - kGestureMargin
+            );
+            ctrl.pan(start.x, start.y, start.x + drag.x, start.y + drag.y);
+            viewport.pan(drag);
+            delta -= drag;
+            is_moved = true;
+        }
+        if (is_moved) {
+            relocalize(viewport, work_area);
+        }
+        skipped_count += paintCells(ctrl, viewport, color_cells, color_coords, tile, work_area);
+    }
+    if (skipped_count) {
+        std::cout << std::format("warning: {} cells were out of the screen and skipped", skipped_count) << std::endl;
+    }
+}
+
+void Screen::relocalize(Viewport& viewport, cv::Rect work_area) {
+    update();
+    screen_image_.refineGrid(viewport.origin, viewport.cell_size, work_area);
+}
+
+void Screen::solveAndPaint(const Nonogram& nonogram) {
+    const int width = nonogram.width;
+    const int height = nonogram.height;
+    const bool is_colored = nonogram.color_count > 1;
+
+    // lines are published by the solver thread and painted by this thread
+    // every line is published at most once, so the queue never overflows
+    SpscQueue<SolvedLine> queue(width + height);
+    std::atomic<bool> is_done = false;
+    // bumped on every published line and once more when the solver is done, the painter sleeps on it while idle
+    std::atomic<size_t> event_count = 0;
+    auto notifyPainter = [&] {
+        event_count.fetch_add(1, std::memory_order_release);
+        event_count.notify_one();
+    };
+    bool is_solved = false;
+    std::jthread solver_thread([&] {
+        Solver solver(nonogram);
+        solver.setLineCallback([&](SolvedLine line) {
+            queue.tryPush(std::move(line));
+            notifyPainter();
+        });
+        is_solved = solver.solve();
+        is_done.store(true, std::memory_order_release);
+        notifyPainter();
+    });
+
+    // parse the screen while the solver is already running and the control session is being connected,
+    // the palette is parsed at the same time as the grid
+    prepareSession();
+    Image nonogram_image = saveErrorImage([&] { return screen_image_.extractNonogram(); });
+    std::vector<cv::Vec3b> palette_colors;
+    std::vector<cv::Point> color_coords;
+    std::future<void> palette_parsing;
+    if (is_colored) {
+        palette_parsing = std::async(std::launch::async, [&] {
+            screen_image_.extractPalette(palette_colors, color_coords, nonogram_image.rect_);
+        });
+    }
+    cv::Vec3b bg_color;
+    Image grid = saveErrorImage([&] { return nonogram_image.extractGrid(bg_color, width, height); });
+    Viewport viewport{
+        cv::Point2d(grid.rect_.x, grid.rect_.y),
+        cv::Size2d((double)grid.mat_.cols / width, (double)grid.mat_.rows / height)
+    };
+    if (is_colored) {
+        palette_parsing.get();
+        if ((int)color_coords.size() < nonogram.color_count) {
+            throw std::runtime_error("error: palette has less colors than the nonogram");
+        }
+    }
+
+    // start painting
+    std::unique_ptr<ControlSession> session = takeSession();
+    ControlSession& ctrl = *session;
+    // rows and columns cross, so every cell is tapped only once
+    std::vector<bool> is_painted(width * height, false);
+    int current_color = 0;
+    int line_count = 0;
+    while (true) {
+        // the counter and the flag must be read before the queue is found empty,
+        // otherwise the last lines may be lost or the painter may sleep through them
+        const size_t seen_event_count = event_count.load(std::memory_order_acquire);
+        const bool is_last = is_done.load(std::memory_order_acquire);
+        SolvedLine line;
+        if (!queue.tryPop(line)) {
+            if (is_last)
+                break;
+            // don't take the CPU from the solver, sleep until it publishes something
+            event_count.wait(seen_event_count, std::memory_order_acquire);
+            continue;
+        }
+        line_count++;
+
+        // tap cells of the line grouped by color, starting with the current one to save a color switch
+        std::vector<std::vector<cv::Point>> color_cells(nonogram.color_count + 1);
+        for (int i = 0; i < (int)line.colors.size(); i++) {
+            const int col = (line.is_row ? i : line.index);
+            const int row = (line.is_row ? line.index : i);
+            if (line.colors[i] == 0 || is_painted[row * width + col])
+                continue;
+            is_painted[row * width + col] = true;
+            color_cells[line.colors[i]].push_back({col, row});
+        }
+        for (int i = 0; i < nonogram.color_count; i++) {
+            const int color = (current_color + i - 1 + nonogram.color_count) % nonogram.color_count + 1;
+            if (color_cells[color].empty())
+                continue;
+            if (is_colored && color != current_color) {
+                ctrl.tap(color_coords[color - 1].x, color_coords[color - 1].y);
+                // after tapping the color the application needs some time to apply it
+                std::this_thread::sleep_for(500ms);
+            }
+            current_color = color;
+            for (const cv::Point& cell : color_cells[color]) {
+                cv::Point point = viewport.toScreen(cell.x, cell.y);
+                // colored nonograms need longer touches, see `paint()`
+                ctrl.tap(point.x, point.y, is_colored ? 20ms : 5ms);
+            }
+        }
+    }
+
+    tap_count_ += ctrl.tapCount();
+    if (!is_solved) {
+        std::cout << "error: the nonogram has no solution" << std::endl;
+    } else {
+        std::cout << std::format("painted {} lines", line_count) << std::endl;
     }
 }
@@ -1,27 +1,85 @@
 #pragma once
 
+#include <future>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "controls.h"
 #include "image.h"
+#include "nonogram.h"
+#include "viewport.h"
 
 // represents the device screen controller
 class Screen {
 public:
     // on every contstruction the screenshot is taken
-    Screen();
+    explicit Screen(Device device = {});
 
     // make a new screenshot
     void update();
+    // start the control session in background, so it's ready by the time painting starts
+    // painting starts its own session if this wasn't called
+    void prepareSession();
 
 public:
     // capture an answer picture from the screen
     // width and height correspond to the actual nonogram sizes
-    void captureAnswer(int width, int height, bool is_colored, const std::vector<int>& margins);
+    // the answer is kept in memory and also saved to the bitmap file for later painting runs
+    // colors of colored answer are clustered into `color_count` colors, 0 to detect the number
+    void captureAnswer(int width, int height, bool is_colored, const std::vector<int>& margins, int color_count);
 
     // paints the answer on the nonogram grid
+    // the answer captured by this screen is used, if there's none it's loaded from the bitmap file
     // width and height correspond to the actual nonogram sizes
-    void paint(int width, int height, bool is_colored, bool is_multimode);
+    // if cells are smaller than `min_cell_size` pixels, the grid is zoomed in and painted tile by tile
+    void paint(int width, int height, bool is_colored, bool is_multimode, int min_cell_size);
+
+    // solves the nonogram by its clues and paints it on the grid at the same time
+    // every line is painted as soon as the solver is sure about it
+    // colors of the nonogram are expected to go in the same order as in the palette on the screen
+    void solveAndPaint(const Nonogram& nonogram);
+
+    // number of taps sent to the device so far
+    int tapCount() const;
+    // number of times the image buffers of the screen had to allocate memory so far
+    int imageAllocationCount() const;
+
+private:
+    // cells of the answer to be painted grouped by the palette colors
+    // black & white nonograms have a single group
+    using ColorCells = std::vector<std::vector<cv::Point>>;
+
+    // zoom in until cells are at least `min_cell_size` pixels and paint the grid tile by tile
+    // `work_area` is the part of the screen the grid occupies at default zoom, only it's used for gestures
+    void paintTiled(ControlSession& ctrl, Viewport viewport, cv::Rect work_area, int width, int height, int min_cell_size,
+                    const ColorCells& color_cells, const std::vector<cv::Point>& color_coords);
+    // take a new screenshot and correct the predicted viewport by the actual grid position
+    void relocalize(Viewport& viewport, cv::Rect work_area);
+    // the session started by `prepareSession()` or a new one, waits until it's connected
+    std::unique_ptr<ControlSession> takeSession();
+    // run image processing, if it fails the image showing the failure is saved under a file name unique for the device
+    template <typename Process>
+    auto saveErrorImage(Process process) {
+        try {
+            return process();
+        } catch (const ImageError& error) {
+            saveImageError(error);
+            throw;
+        }
+    }
+    void saveImageError(const ImageError& error) const;
+    // output file name that is unique for the device, e.g. `bitmap.bmp` becomes `bitmap_<serial>.bmp`
+    std::string devicePath(const std::string& file_name) const;
 
 private:
+    Device device_;
+    // working buffers of all the images taken from this screen, must outlive them
+    ImageBuffers image_buffers_;
     Image screen_image_;
+    // answer bitmap with one pixel per cell, grayscale for black & white nonograms
+    cv::Mat answer_;
+    int tap_count_ = 0;
+    // control session being connected in background
+    std::future<std::unique_ptr<ControlSession>> session_;
 };
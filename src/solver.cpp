@@ -0,0 +1,177 @@
+#include "solver.h"
+
+#include <algorithm>
+#include <bit>
+#include <queue>
+
+namespace {
+    bool isSolved(Cell cell) {
+        return std::has_single_bit(cell);
+    }
+}
+
+Solver::Solver(const Nonogram& nonogram)
+    : nonogram_(nonogram),
+      line_count_(nonogram.height + nonogram.width),
+      grid_(nonogram.width * nonogram.height, (Cell(1) << (nonogram.color_count + 1)) - 1),
+      is_published_(line_count_, false) {}
+
+void Solver::setLineCallback(LineCallback callback) {
+    callback_ = std::move(callback);
+}
+
+void Solver::setLineCache(LineCache* cache) {
+    cache_ = cache;
+}
+
+bool Solver::solve() {
+    return countSolutions(1) > 0;
+}
+
+int Solver::countSolutions(int max_count) {
+    std::vector<int> all_lines(line_count_);
+    for (int i_line = 0; i_line < line_count_; i_line++) {
+        all_lines[i_line] = i_line;
+    }
+    if (!propagate(grid_, all_lines, true))
+        return 0;
+    const int count = search(grid_, max_count);
+    // report the lines that were solved by the search
+    if (count > 0) {
+        for (int i_line = 0; i_line < line_count_; i_line++) {
+            publishLine(grid_, i_line);
+        }
+    }
+    return count;
+}
+
+std::vector<int> Solver::solution() const {
+    std::vector<int> colors(grid_.size());
+    for (size_t i = 0; i < grid_.size(); i++) {
+        colors[i] = std::countr_zero(grid_[i]);
+    }
+    return colors;
+}
+
+const Solver::Stats& Solver::stats() const {
+    return stats_;
+}
+
+void Solver::readLine(const Grid& grid, int i_line, std::vector<Cell>& line) const {
+    if (i_line < nonogram_.height) {
+        auto begin = grid.begin() + i_line * nonogram_.width;
+        line.assign(begin, begin + nonogram_.width);
+    } else {
+        const int col = i_line - nonogram_.height;
+        line.resize(nonogram_.height);
+        for (int row = 0; row < nonogram_.height; row++) {
+            line[row] = grid[row * nonogram_.width + col];
+        }
+    }
+}
+
+bool Solver::propagate(Grid& grid, const std::vector<int>& dirty_lines, bool is_root) {
+    // lines with less unknown cells go first: they are the cheapest to finish
+    // and finished lines can be painted while the rest is being solved
+    using Entry = std::pair<int, int>;  // (unknown cell count, line index)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    std::vector<bool> is_queued(line_count_, false);
+    std::vector<Cell> line;
+    auto enqueue = [&](int i_line) {
+        if (is_queued[i_line])
+            return;
+        is_queued[i_line] = true;
+        readLine(grid, i_line, line);
+        queue.push({(int)std::ranges::count_if(line, [](Cell cell) { return !isSolved(cell); }), i_line});
+    };
+    for (int i_line : dirty_lines) {
+        enqueue(i_line);
+    }
+
+    std::vector<Cell> solved;
+    while (!queue.empty()) {
+        const int i_line = queue.top().second;
+        queue.pop();
+        is_queued[i_line] = false;
+
+        const bool is_row = i_line < nonogram_.height;
+        readLine(grid, i_line, solved);
+        const Clue& clue = (is_row ? nonogram_.rows[i_line] : nonogram_.cols[i_line - nonogram_.height]);
+        stats_.line_count++;
+        if (!(cache_ ? cache_->solveLine(clue, solved) : solveLine(clue, solved)))
+            return false;
+
+        // write changes back and wake up crossing lines
+        for (int i = 0; i < (int)solved.size(); i++) {
+            const int row = (is_row ? i_line : i);
+            const int col = (is_row ? i : i_line - nonogram_.height);
+            Cell& cell = grid[row * nonogram_.width + col];
+            if (cell == solved[i])
+                continue;
+            cell = solved[i];
+            enqueue(is_row ? nonogram_.height + col : row);
+        }
+        if (is_root) {
+            publishLine(grid, i_line);
+        }
+    }
+    return true;
+}
+
+int Solver::search(Grid& grid, int max_count) {
+    // guess the cell with the least number of options
+    int best_cell = -1;
+    int best_count = 0;
+    for (int i = 0; i < (int)grid.size(); i++) {
+        const int count = std::popcount(grid[i]);
+        if (count > 1 && (best_cell < 0 || count < best_count)) {
+            best_cell = i;
+            best_count = count;
+            if (count == 2)
+                break;
+        }
+    }
+    // propagation has already checked every line, so the complete grid is a solution
+    if (best_cell < 0)
+        return 1;
+
+    const int row = best_cell / nonogram_.width;
+    const int col = best_cell % nonogram_.width;
+    int solution_count = 0;
+    Grid first_solution;
+    for (Cell options = grid[best_cell]; options && solution_count < max_count; options &= options - 1) {
+        stats_.node_count++;
+        Grid guess = grid;
+        guess[best_cell] = options & -options;
+        if (!propagate(guess, {row, nonogram_.height + col}, false))
+            continue;
+        const int count = search(guess, max_count - solution_count);
+        if (count > 0 && solution_count == 0) {
+            first_solution = std::move(guess);
+        }
+        solution_count += count;
+    }
+    if (solution_count > 0) {
+        grid = std::move(first_solution);
+    }
+    return solution_count;
+}
+
+void Solver::publishLine(const Grid& grid, int i_line) {
+    if (!callback_ || is_published_[i_line])
+        return;
+    std::vector<Cell> line;
+    readLine(grid, i_line, line);
+    if (!std::ranges::all_of(line, isSolved))
+        return;
+    is_published_[i_line] = true;
+
+    SolvedLine solved_line;
+    solved_line.is_row = i_line < nonogram_.height;
+    solved_line.index = (solved_line.is_row ? i_line : i_line - nonogram_.height);
+    solved_line.colors.resize(line.size());
+    for (size_t i = 0; i < line.size(); i++) {
+        solved_line.colors[i] = std::countr_zero(line[i]);
+    }
+    callback_(std::move(solved_line));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "line_cache.h"
+#include "line_solver.h"
+#include "nonogram.h"
+
+// fully determined line of the nonogram
+struct SolvedLine {
+    bool is_row = true;
+    int index = 0;
+    // colors of the cells, 0 is the background
+    std::vector<int> colors;
+};
+
+// constraint propagation solver with backtracking search for the lines that can't be deduced
+class Solver {
+public:
+    // called once for every line as soon as it's known for sure
+    // lines deduced inside of the search are reported only after the search succeeds
+    using LineCallback = std::function<void(SolvedLine line)>;
+
+    // counters of the work done by the solver
+    struct Stats {
+        // number of lines passed to the line solver
+        long long line_count = 0;
+        // number of guesses made by the search
+        long long node_count = 0;
+    };
+
+    explicit Solver(const Nonogram& nonogram);
+
+    void setLineCallback(LineCallback callback);
+    // use the cache for line solving results, the cache may be shared with other solvers
+    void setLineCache(LineCache* cache);
+
+    // returns false if the nonogram has no solution
+    bool solve();
+    // count solutions, but stop as soon as `max_count` of them are found
+    // the first found solution is kept. Lines are reported the same way as by `solve()`
+    int countSolutions(int max_count);
+
+
+    // colors of the solved grid in row-major order, 0 is the background
+    std::vector<int> solution() const;
+
+    const Stats& stats() const;
+
+private:
+    using Grid = std::vector<Cell>;
+
+    // propagate constraints starting from the given lines until nothing changes
+    // lines are indexed with rows first and then columns
+    // returns false on contradiction
+    bool propagate(Grid& grid, const std::vector<int>& dirty_lines, bool is_root);
+    // guess cells and propagate recursively until `max_count` solutions are found
+    // the grid is replaced with the first found solution. Returns number of found solutions
+    int search(Grid& grid, int max_count);
+
+    // copy cells of the line from the grid
+    void readLine(const Grid& grid, int i_line, std::vector<Cell>& line) const;
+    // report the line if it's fully determined and wasn't reported yet
+    void publishLine(const Grid& grid, int i_line);
+
+private:
+    const Nonogram& nonogram_;
+    const int line_count_;
+    Grid grid_;
+    LineCallback callback_;
+    LineCache* cache_ = nullptr;
+    std::vector<bool> is_published_;
+    Stats stats_;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+// lock-free bounded queue for exactly one producer thread and one consumer thread
+template <typename T>
+class SpscQueue {
+public:
+    // capacity is rounded up to the power of two
+    explicit SpscQueue(size_t capacity)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 1))),
+          buffer_(std::make_unique<T[]>(capacity_)) {}
+    // disabled copy and move operations
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    SpscQueue(SpscQueue&&) = delete;
+    SpscQueue& operator=(SpscQueue&&) = delete;
+
+public:
+    // must be called from the producer thread only
+    // returns false if the queue is full
+    bool tryPush(T value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == capacity_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == capacity_)
+                return false;
+        }
+        buffer_[tail & (capacity_ - 1)] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // must be called from the consumer thread only
+    // returns false if the queue is empty
+    bool tryPop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+                return false;
+        }
+        value = std::move(buffer_[head & (capacity_ - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // producer and consumer data live on separate cache lines to not bounce them between cores
+    static constexpr size_t kCacheLineSize = 64;
+
+    const size_t capacity_;
+    std::unique_ptr<T[]> buffer_;
+    // consumer side: read position and the last seen write position
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;
+    // producer side: write position and the last seen read position
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;
+};
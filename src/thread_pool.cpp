@@ -0,0 +1,93 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < thread_count; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < thread_count; i++) {
+        threads_.emplace_back([this, i] { run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard lock(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    task_added_.notify_all();
+    // join threads before the members they use are destroyed
+    threads_.clear();
+}
+
+unsigned ThreadPool::threadCount() const {
+    return threads_.size();
+}
+
+void ThreadPool::submit(Task task) {
+    pending_count_++;
+    Worker& worker = *workers_[next_worker_++ % workers_.size()];
+    {
+        std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    queued_count_++;
+    // lock to not miss a worker that is just about to fall asleep
+    { std::lock_guard lock(sleep_mutex_); }
+    task_added_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock(sleep_mutex_);
+    all_done_.wait(lock, [this] { return pending_count_ == 0; });
+}
+
+bool ThreadPool::takeTask(unsigned i_worker, Task& task) {
+    // own tasks are taken from the front, in submission order
+    {
+        Worker& worker = *workers_[i_worker];
+        std::lock_guard lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            queued_count_--;
+            return true;
+        }
+    }
+    // others' tasks are stolen from the front, starting with the next worker
+    for (size_t i = 1; i < workers_.size(); i++) {
+        Worker& victim = *workers_[(i_worker + i) % workers_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_count_--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(unsigned i_worker) {
+    while (true) {
+        Task task;
+        if (takeTask(i_worker, task)) {
+            task();
+            if (--pending_count_ == 0) {
+                { std::lock_guard lock(sleep_mutex_); }
+                all_done_.notify_all();
+            }
+            continue;
+        }
+        // nothing to do: sleep until a new task is added
+        std::unique_lock lock(sleep_mutex_);
+        task_added_.wait(lock, [this] { return is_stopping_ || queued_count_ > 0; });
+        if (is_stopping_)
+            return;
+    }
+}
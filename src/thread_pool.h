@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing thread pool
+// every worker has its own task deque: it takes tasks from the front of its own deque,
+// so tasks run in the order they were submitted, and steals from the front of the others' deques when it runs out of work
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(unsigned thread_count = 0);
+    // disabled copy and move operations
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+    // waits for all the tasks to finish
+    ~ThreadPool();
+
+public:
+    unsigned threadCount() const;
+
+    // add task, tasks are spread over the workers evenly
+    void submit(Task task);
+    // block until all submitted tasks are finished
+    void wait();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(unsigned i_worker);
+    // take task from own deque or steal one from the others
+    bool takeTask(unsigned i_worker, Task& task);
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::jthread> threads_;
+    // worker that gets the next submitted task
+    std::atomic<unsigned> next_worker_ = 0;
+    // number of submitted but not finished tasks
+    std::atomic<int> pending_count_ = 0;
+    // number of submitted tasks that are not taken by workers yet
+    std::atomic<int> queued_count_ = 0;
+    // sleeping workers wait for new tasks, `wait()` waits for pending count to become 0
+    std::mutex sleep_mutex_;
+    std::condition_variable task_added_;
+    std::condition_variable all_done_;
+    bool is_stopping_ = false;
+};
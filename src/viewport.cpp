@@ -0,0 +1,50 @@
+#include "viewport.h"
+
+#include <algorithm>
+
+cv::Point Viewport::toScreen(int col, int row) const {
+    return cv::Point(
+        origin.x + (col + 0.5) * cell_size.width,
+        origin.y + (row + 0.5) * cell_size.height
+    );
+}
+
+cv::Rect2d Viewport::toScreen(cv::Rect cells) const {
+    return cv::Rect2d(
+        origin.x + cells.x * cell_size.width,
+        origin.y + cells.y * cell_size.height,
+        cells.width * cell_size.width,
+        cells.height * cell_size.height
+    );
+}
+
+void Viewport::zoom(cv::Point2d center, double scale) {
+    // the point under the center stays in place, everything else moves away from it
+    origin = center + (origin - center) * scale;
+    cell_size.width *= scale;
+    cell_size.height *= scale;
+}
+
+void Viewport::pan(cv::Point2d delta) {
+    origin += delta;
+}
+
+std::vector<cv::Rect> planTiles(int width, int height, cv::Size tile_size) {
+    tile_size.width = std::clamp(tile_size.width, 1, width);
+    tile_size.height = std::clamp(tile_size.height, 1, height);
+    const int tile_cols = (width + tile_size.width - 1) / tile_size.width;
+    const int tile_rows = (height + tile_size.height - 1) / tile_size.height;
+
+    std::vector<cv::Rect> tiles;
+    tiles.reserve(tile_cols * tile_rows);
+    for (int tile_row = 0; tile_row < tile_rows; tile_row++) {
+        for (int i = 0; i < tile_cols; i++) {
+            // odd rows of tiles go backwards
+            const int tile_col = (tile_row % 2 == 0 ? i : tile_cols - 1 - i);
+            cv::Rect tile(tile_col * tile_size.width, tile_row * tile_size.height, tile_size.width, tile_size.height);
+            // the last tiles may be smaller
+            tiles.push_back(tile & cv::Rect(0, 0, width, height));
+        }
+    }
+    return tiles;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// maps nonogram cells to screen coordinates while the grid is being zoomed and panned
+struct Viewport {
+    // screen position of the top-left corner of the grid
+    cv::Point2d origin;
+    // cell sizes in pixels
+    cv::Size2d cell_size;
+
+    // screen position of the center of the cell
+    cv::Point toScreen(int col, int row) const;
+    // screen rect covered by the cells
+    cv::Rect2d toScreen(cv::Rect cells) const;
+    // predict the grid position after zooming by `scale` around `center`
+    void zoom(cv::Point2d center, double scale);
+    // predict the grid position after dragging it by `delta`
+    void pan(cv::Point2d delta);
+};
+
+// split the nonogram into tiles of at most `tile_size` cells
+// tiles are ordered like a snake (left to right, then right to left on the next row of tiles and so on)
+// so every next tile is a neighbour of the previous one and is reached with a single pan
+std::vector<cv::Rect> planTiles(int width, int height, cv::Size tile_size);